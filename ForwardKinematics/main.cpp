@@ -4,11 +4,17 @@ Computer animation assignment 1: particle system for softbody (jelly) simulation
 First step: Search TODO comments to find the methods that you need to implement.
     - src/simulation/kinematics.cpp
 */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <string>
 
 #include "Eigen/Core"
 #include "GLFW/glfw3.h"
@@ -39,12 +45,28 @@ graphics::FreeCamera freeCamera;
 graphics::Camera* currentCamera = &defaultCamera;
 // Switch for render camera control panel
 bool isUsingCameraPanel = false;
-// 1 / Simulation speed
-int playSpeed = 1;
+// Playback speed, 1 is real time
+float playSpeed = 1.0f;
 // Is free camera?
 bool isUsingFreeCamera = false;
 // Time Warping mode or not
 bool isTimeWarping = false;
+// Time warping moves keyframe warpKeyframeOld to warpKeyframeNew
+int warpKeyframeOld = 160, warpKeyframeNew = 150;
+// Time warping parameters are edited in the panel
+bool isWarpChanged = false;
+// Layer the punch's upper body on top of the running motion
+bool isLayering = false;
+// Overlay a low-pass filtered copy of the running motion
+bool isFiltering = false;
+// Filter parameters are edited in the panel, the copy is refiltered when they change
+int filterType = 0;
+float filterSigma = 0.025f, filterCutoff = 6.0f;
+bool isFilterChanged = false;
+// Pick animation level of detail by screen-space size
+bool isUsingLOD = false;
+// Screen-space thresholds for animation level of detail
+kinematics::LODPolicy lodPolicy;
 // is simulating
 bool isSimulating = false;
 // Mouse is disabled?
@@ -100,9 +122,41 @@ void cameraPanel(GLFWwindow* window);
 void renderUI(GLFWwindow* window, int* frame, int maxFrame);
 
 int main() {
+    // Startup is timed up to the first frame on screen
+    auto startTime = std::chrono::steady_clock::now();
     GLFWwindow* window = initialize();
     // No window created
     if (window == nullptr) return 1;
+    // Decoding images and reading shaders does not need the GL context, it runs on the thread pool while this
+    // thread sets up the skeletons and GL objects. Only the uploads below wait for it
+    auto shader_folder = util::PathFinder::find("Shader");
+    auto texture_folder = util::PathFinder::find("Texture");
+    const std::array<util::fs::path, 6> skyboxFileList = {
+        texture_folder / "skybox0.png", texture_folder / "skybox1.png", texture_folder / "skybox2.png",
+        texture_folder / "skybox3.png", texture_folder / "skybox4.png", texture_folder / "skybox5.png"};
+    // Vertex then fragment shader of the shadow, render and skybox programs
+    const std::array<util::fs::path, 6> shaderFileList = {
+        shader_folder / "shadow.vert", shader_folder / "shadow.frag", shader_folder / "render.vert",
+        shader_folder / "render.frag", shader_folder / "skybox.vert", shader_folder / "skybox.frag"};
+    graphics::Image woodImage;
+    std::array<graphics::Image, 6> skyboxImages;
+    std::array<std::string, 6> shaderSources;
+    auto assetLoading = std::async(std::launch::async, [&]() {
+        // Item 0 is the wood texture, then the skybox faces and the shaders
+        std::size_t shaderBegin = 1 + skyboxImages.size();
+        auto load = [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                if (i == 0) {
+                    woodImage = graphics::loadImage(texture_folder / "wood.png", true);
+                } else if (i < shaderBegin) {
+                    skyboxImages[i - 1] = graphics::loadImage(skyboxFileList[i - 1], false);
+                } else {
+                    shaderSources[i - shaderBegin] = graphics::Shader::readSource(shaderFileList[i - shaderBegin]);
+                }
+            }
+        };
+        util::ThreadPool::global().parallelFor(shaderBegin + shaderSources.size(), 1, load);
+    });
     // Shader programs
     graphics::Program renderProgram;
     graphics::Program skyboxRenderProgram;
@@ -113,35 +167,46 @@ int main() {
     graphics::Box skybox;
     auto acclaim_folder = util::PathFinder::find("Acclaim");
     auto skeleton = std::make_unique<acclaim::Skeleton>(acclaim_folder / "skeleton.asf", 0.2);
-    acclaim::Motion running(acclaim_folder / "running.amc", std::make_unique<acclaim::Skeleton>(*skeleton));
-    acclaim::Motion punch(acclaim_folder / "punch_kick.amc", std::move(skeleton));
+    // Clips start empty and grow as the loaders parse them, playback starts with the first frames.
+    // AMC files do not store the capture rate, CMU data is recorded at 120 Hz
+    acclaim::Motion running(std::vector<acclaim::Posture>(), std::make_unique<acclaim::Skeleton>(*skeleton), 120.0);
+    acclaim::Motion punch(std::vector<acclaim::Posture>(), std::move(skeleton), 120.0);
+    acclaim::AMCLoader runningLoader(acclaim_folder / "running.amc", running.getSkeleton().get());
+    acclaim::AMCLoader punchLoader(acclaim_folder / "punch_kick.amc", punch.getSkeleton().get());
+    std::vector<acclaim::Posture> loadedPostures;
     acclaim::Motion punchWarped = punch;
     punchWarped.getSkeleton()->setBoneColor(Eigen::Vector4f(0.12f, 0.28f, 0.53f, 0.0f));
-    punchWarped.timeWarper(160, 150);
+    punchWarped.timeWarper(warpKeyframeOld, warpKeyframeNew);
+    kinematics::FilterOptions filterOptions;
+    acclaim::Motion runningFiltered = running.filter(filterOptions);
+    runningFiltered.getSkeleton()->setBoneColor(Eigen::Vector4f(0.12f, 0.28f, 0.53f, 0.0f));
     graphics::Plane plane;
-    // Load data from assets
+    // Upload data from assets
     {
-        auto shader_folder = util::PathFinder::find("Shader");
-        auto texture_folder = util::PathFinder::find("Texture");
-        graphics::Shader shadowVertexShader(shader_folder / "shadow.vert", GL_VERTEX_SHADER);
-        graphics::Shader shadowFragmentShader(shader_folder / "shadow.frag", GL_FRAGMENT_SHADER);
-        graphics::Shader renderVertexShader(shader_folder / "render.vert", GL_VERTEX_SHADER);
-        graphics::Shader renderFragmentShader(shader_folder / "render.frag", GL_FRAGMENT_SHADER);
-        graphics::Shader skyboxVertexShader(shader_folder / "skybox.vert", GL_VERTEX_SHADER);
-        graphics::Shader skyboxFragmentShader(shader_folder / "skybox.frag", GL_FRAGMENT_SHADER);
-        auto wood = std::make_shared<graphics::Texture>(texture_folder / "wood.png");
+        assetLoading.get();
+        auto wood = std::make_shared<graphics::Texture>(woodImage);
         plane.setTexture(wood);
-        auto skyboxFileList = std::array<util::fs::path, 6>(
-            {texture_folder / "skybox0.png", texture_folder / "skybox1.png", texture_folder / "skybox2.png",
-             texture_folder / "skybox3.png", texture_folder / "skybox4.png", texture_folder / "skybox5.png"});
-        auto sky = std::make_shared<graphics::CubeTexture>(skyboxFileList);
-        // Setup shaders, these objects can be destroyed after linkShader()
-        renderProgram.attachLinkShader(renderVertexShader, renderFragmentShader);
-        shadowProgram.attachLinkShader(shadowVertexShader, shadowFragmentShader);
-        skyboxRenderProgram.attachLinkShader(skyboxVertexShader, skyboxFragmentShader);
+        auto sky = std::make_shared<graphics::CubeTexture>(skyboxImages);
+        // Setup shaders, programs linked before on this driver are loaded from their cached binaries
+        auto shader_cache_folder = util::PathFinder::find("ShaderCache");
+        int cachedPrograms = 0;
+        cachedPrograms += renderProgram.linkCached(shader_cache_folder, shaderSources[2], shaderSources[3]);
+        cachedPrograms += shadowProgram.linkCached(shader_cache_folder, shaderSources[0], shaderSources[1]);
+        cachedPrograms += skyboxRenderProgram.linkCached(shader_cache_folder, shaderSources[4], shaderSources[5]);
+        std::cout << std::left << std::setw(26) << "Cached shader programs"
+                  << ": " << cachedPrograms << " / 3" << std::endl;
         skybox.setTexture(sky);
+        // Decoded pixels are on the GPU now
+        woodImage = graphics::Image();
+        skyboxImages = std::array<graphics::Image, 6>();
     }
 
+    // Running lower body with punching upper body
+    kinematics::BlendTree layers(running.getSkeleton()->getBoneNum());
+    int runningLayer = layers.addClip(&running);
+    int punchLayer = layers.addClip(&punch);
+    layers.addBlend(runningLayer, punchLayer, 1.0, kinematics::subtreeMask(running.getSkeleton().get(), "lowerback"));
+
     kinematics::Ball ball(punchWarped.getSkeleton()->getBonePointer(("rfingers")));
     ball.getGraphics()->setTexture(Eigen::Vector4f(0.596f, 0.404f, 0.773f, 0.0f));
 
@@ -159,32 +224,80 @@ int main() {
         renderProgram.setUniform("shadowMap", shadow.getIndex());
         renderProgram.setUniform("lightPos", lightPosition);
     }
-    int currentFrame = 0, speedControl = 0, totalFrames = 0;
+    int currentFrame = 0, totalFrames = 0;
+    bool isFirstFrame = true;
+    // Playback is driven by wall clock so that it does not depend on the refresh rate
+    double playTime = 0.0, lastTime = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
-        if (isTimeWarping)
-            totalFrames = punchWarped.getFrameNum();
-        else
-            totalFrames = running.getFrameNum();
+        // Take frames parsed since the last iteration
+        if (runningLoader.poll(&loadedPostures) > 0) {
+            running.appendPostures(loadedPostures);
+            loadedPostures.clear();
+            isFilterChanged = true;
+        }
+        if (punchLoader.poll(&loadedPostures) > 0) {
+            punch.appendPostures(loadedPostures);
+            punchWarped.appendPostures(loadedPostures);
+            loadedPostures.clear();
+        }
+        acclaim::Motion& shownMotion = isTimeWarping ? punchWarped : running;
+        // Only the loaded part can be played or picked in the panel
+        totalFrames = shownMotion.getFrameNum();
+        bool isShownLoaded = totalFrames > 0 && (!isLayering || punch.getFrameNum() > 0);
+        double now = glfwGetTime();
+        if (isSimulating && isShownLoaded) {
+            playTime = std::fmod(playTime + (now - lastTime) * playSpeed, shownMotion.getDuration());
+        }
+        lastTime = now;
+        currentFrame = std::max(0, std::min(static_cast<int>(playTime * shownMotion.getFrameRate()), totalFrames - 1));
         // Moving camera only if debug camera is on.
         if (isUsingFreeCamera) {
             if (isMouseBinded) freeCamera.moveSight(window);
             freeCamera.moveCamera(window);
         }
         currentCamera->update();
-        if (isTimeWarping) {
-            punch.setBoneTransform(currentFrame);
-            punchWarped.setBoneTransform(currentFrame);
+        if (isUsingLOD) {
+            // Bones still hold last frame's pose which is close enough for measuring size
+            Eigen::Matrix4f view = currentCamera->getViewMatrix();
+            Eigen::Matrix4f projection = currentCamera->getProjectionMatrix();
+            for (acclaim::Motion* motion : {&running, &runningFiltered, &punch, &punchWarped}) {
+                auto&& motionSkeleton = motion->getSkeleton();
+                double size = kinematics::screenSpaceSize(motionSkeleton.get(), view, projection, g_ScreenHeight);
+                motion->setLOD(lodPolicy.select(size));
+            }
+        } else {
+            for (acclaim::Motion* motion : {&running, &runningFiltered, &punch, &punchWarped}) {
+                motion->setLOD(kinematics::LODSelection());
+            }
+        }
+        if (isWarpChanged) {
+            punchWarped.timeWarper(warpKeyframeOld, warpKeyframeNew);
+            isWarpChanged = false;
+        }
+        // Filtered copy is refreshed when it is shown, also after more of the running clip is loaded
+        if (isFilterChanged && isFiltering) {
+            filterOptions.type =
+                filterType == 0 ? kinematics::FilterType::Gaussian : kinematics::FilterType::Butterworth;
+            filterOptions.sigma = filterSigma;
+            filterOptions.cutoff = filterCutoff;
+            running.filter(filterOptions, &runningFiltered);
+            isFilterChanged = false;
+        }
+        if (!isShownLoaded) {
+            // Nothing parsed yet, bones stay in the rest pose
+        } else if (isTimeWarping) {
+            punch.sample(playTime);
+            punchWarped.sample(playTime);
             // This should run after motion is set
             ball.set_model_matrix(currentFrame);
+        } else if (isLayering) {
+            layers.setTime(runningLayer, playTime);
+            layers.setTime(punchLayer, playTime);
+            kinematics::forwardSolverBatch(layers.evaluate(), running.getSkeleton().get());
+            running.getSkeleton()->setModelMatrices();
         } else {
-            running.setBoneTransform(currentFrame);
-        }
-
-        if (isSimulating) {
-            //if (((++speedControl) %= playSpeed) == 0) {
-                ++currentFrame;
-                currentFrame %= totalFrames;
-            //}
+            running.sample(playTime);
+            if (isFiltering) runningFiltered.sample(playTime);
         }
         // 1. Render shadow to texture
         glViewport(0, 0, shadow.getShadowSize(), shadow.getShadowSize());
@@ -196,6 +309,8 @@ int main() {
         if (isTimeWarping) {
             ball.getGraphics()->render(&shadowProgram);
             punchWarped.getSkeleton()->render(&shadowProgram);
+        } else if (isFiltering && !isLayering) {
+            runningFiltered.getSkeleton()->render(&shadowProgram);
         } else {
             running.getSkeleton()->render(&shadowProgram);
         }
@@ -215,6 +330,11 @@ int main() {
             glPolygonOffset(1.0f, 1.0f);
             punchWarped.getSkeleton()->render(&renderProgram);
             glPolygonOffset(0.0f, 0.0f);
+        } else if (isFiltering && !isLayering) {
+            running.getSkeleton()->render(&renderProgram);
+            glPolygonOffset(1.0f, 1.0f);
+            runningFiltered.getSkeleton()->render(&renderProgram);
+            glPolygonOffset(0.0f, 0.0f);
         } else {
             running.getSkeleton()->render(&renderProgram);
         }
@@ -224,9 +344,18 @@ int main() {
         skyboxRenderProgram.setUniform("view", currentCamera->getViewMatrix());
         skybox.render(&skyboxRenderProgram);
         // 4. Render ImGui UI
+        int shownFrame = currentFrame;
         renderUI(window, &currentFrame, totalFrames);
+        // Frame picked in the panel
+        if (currentFrame != shownFrame) playTime = currentFrame / shownMotion.getFrameRate();
         glFlush();
         glfwSwapBuffers(window);
+        if (isFirstFrame) {
+            std::chrono::duration<double, std::milli> startup = std::chrono::steady_clock::now() - startTime;
+            std::cout << std::left << std::setw(26) << "Time to first frame"
+                      << ": " << startup.count() << " ms" << std::endl;
+            isFirstFrame = false;
+        }
         // Keyboard and mouse inputs.
         glfwPollEvents();
     }
@@ -292,6 +421,8 @@ GLFWwindow* initialize() {
               << ": " << maxTextureSize << " * " << maxTextureSize << std::endl;
     std::cout << std::left << std::setw(26) << "Shadow texture size"
               << ": " << shadowTextureSize << " * " << shadowTextureSize << std::endl;
+    std::cout << std::left << std::setw(26) << "SIMD kernels"
+              << ": " << util::simd::kernels().name << std::endl;
     // Setup Opengl
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
@@ -318,8 +449,6 @@ GLFWwindow* initialize() {
     void* temp = std::malloc(sizeof(forkawesome));
     std::memcpy(temp, forkawesome, sizeof(forkawesome));
     io.Fonts->AddFontFromMemoryTTF(temp, 1, 13.0f, &config, icon_ranges);
-    // Setup simulation speed
-    playSpeed = vidMode->refreshRate / 60;
     return window;
 }
 
@@ -347,7 +476,7 @@ void shutdown() {
 
 void mainPanel(int* frame, int maxFrame) {
     // Main Panel
-    ImGui::SetNextWindowSize(ImVec2(320.0f, 100.0f), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(320.0f, 260.0f), ImGuiCond_Once);
     ImGui::SetNextWindowCollapsed(0, ImGuiCond_Once);
     ImGui::SetNextWindowPos(ImVec2(335.0f, 640.0f), ImGuiCond_Once);
     ImGui::SetNextWindowBgAlpha(0.2f);
@@ -358,7 +487,9 @@ void mainPanel(int* frame, int maxFrame) {
             isUsingCameraPanel ^= true;
         }
         // Simulation Control Panel is disabled now
-        ImGui::SliderInt("Current frame", frame, 0, maxFrame - 1);
+        // Clips still loading only offer the frames parsed so far
+        ImGui::SliderInt("Current frame", frame, 0, std::max(0, maxFrame - 1));
+        ImGui::SliderFloat("Play speed", &playSpeed, 0.1f, 4.0f, "%.2fx");
         if (ImGui::Button(ICON_PLAY)) {
             isSimulating = true;
         }
@@ -377,7 +508,7 @@ void mainPanel(int* frame, int maxFrame) {
         }
         ImGui::SameLine();
         if (ImGui::Button(ICON_PLUS)) {
-            *frame = std::min(maxFrame - 1, *frame + 1);
+            *frame = std::max(0, std::min(maxFrame - 1, *frame + 1));
         }
         ImGui::SameLine();
         if (ImGui::Button("Time Warping")) {
@@ -386,6 +517,34 @@ void mainPanel(int* frame, int maxFrame) {
         }
         ImGui::SameLine();
         ImGui::Text(isTimeWarping ? "ON" : "OFF");
+        if (isTimeWarping) {
+            // Warping is evaluated lazily, only frames being shown are recomputed
+            isWarpChanged |= ImGui::SliderInt("Old keyframe", &warpKeyframeOld, 1, maxFrame - 1);
+            isWarpChanged |= ImGui::SliderInt("New keyframe", &warpKeyframeNew, 1, maxFrame - 1);
+        }
+        if (ImGui::Button("Animation LOD")) {
+            isUsingLOD ^= true;
+        }
+        ImGui::SameLine();
+        ImGui::Text(isUsingLOD ? "ON" : "OFF");
+        if (ImGui::Button("Layered Punch")) {
+            isLayering ^= true;
+        }
+        ImGui::SameLine();
+        ImGui::Text(isLayering ? "ON" : "OFF");
+        if (ImGui::Button("Filter")) {
+            isFiltering ^= true;
+        }
+        ImGui::SameLine();
+        ImGui::Text(isFiltering ? "ON" : "OFF");
+        if (isFiltering) {
+            isFilterChanged |= ImGui::Combo("Filter type", &filterType, "Gaussian\0Butterworth\0");
+            if (filterType == 0) {
+                isFilterChanged |= ImGui::SliderFloat("Sigma", &filterSigma, 0.0f, 0.2f, "%.3f s");
+            } else {
+                isFilterChanged |= ImGui::SliderFloat("Cutoff", &filterCutoff, 0.5f, 30.0f, "%.1f Hz");
+            }
+        }
         ImGui::End();
     }
 }
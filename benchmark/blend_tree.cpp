@@ -0,0 +1,109 @@
+// Evaluates thousands of blend trees per frame, the way a crowd would drive them, and reports the time per tree.
+// BlendTree::evaluate() promises not to allocate after the first call, the run fails if it does.
+//
+// Usage: BlendTreeBenchmark [tree count = 2000] [frame count = 20]
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Linked library code refers to the GL loader, nothing here calls GL so no context is needed
+#define GLAD_GL_IMPLEMENTATION
+#include "glad/gl.h"
+#undef GLAD_GL_IMPLEMENTATION
+
+#include "acclaim/motion.h"
+#include "acclaim/skeleton.h"
+#include "simulation/blend_tree.h"
+
+namespace {
+std::atomic<long> allocations{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) throw std::bad_alloc();
+    return memory;
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+namespace {
+// Same layout as the CMU skeleton: 31 bones, lowerback (11) and the 19 bones below it are the upper body
+constexpr int bone_num = 31;
+constexpr int upper_body = 11;
+constexpr double frame_rate = 120.0;
+
+// Smooth clip with AMC-like ranges, every bone and channel moves at its own frequency
+std::unique_ptr<acclaim::Motion> makeClip(int frame_num, double speed) {
+    std::vector<acclaim::Posture> postures(frame_num, acclaim::Posture(bone_num));
+    for (int i = 0; i < frame_num; ++i) {
+        double time = i / frame_rate;
+        for (int j = 0; j < bone_num; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                postures[i].bone_rotations[j][k] = 60.0 * std::sin(speed * time * (1.0 + 0.1 * j) + k);
+            }
+        }
+        postures[i].bone_translations[0] << 2.0 * speed * time, 17.0 + std::sin(4.0 * time), 0.0, 0.0;
+    }
+    return std::make_unique<acclaim::Motion>(std::move(postures), nullptr, frame_rate);
+}
+
+// Two clips, the upper body of the second one over the first one, then the second one added on top
+kinematics::BlendTree makeTree(acclaim::Motion* lower, acclaim::Motion* upper, bool euler_angles) {
+    std::vector<double> mask(bone_num, 0.0);
+    for (int j = upper_body; j < bone_num; ++j) mask[j] = 1.0;
+    kinematics::BlendTree tree(bone_num, euler_angles);
+    int lower_node = tree.addClip(lower);
+    int upper_node = tree.addClip(upper);
+    int blend = tree.addBlend(lower_node, upper_node, 0.7, mask);
+    tree.addAdditive(blend, upper_node, 0.2, 0.5);
+    return tree;
+}
+
+// Returns false if evaluate() allocated after the warm up frame
+bool run(acclaim::Motion* lower, acclaim::Motion* upper, int tree_num, int frame_num, bool euler_angles) {
+    std::vector<kinematics::BlendTree> trees;
+    trees.reserve(tree_num);
+    for (int i = 0; i < tree_num; ++i) trees.emplace_back(makeTree(lower, upper, euler_angles));
+    for (kinematics::BlendTree& tree : trees) tree.evaluate();
+
+    long allocations_before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frame_num; ++frame) {
+        for (int i = 0; i < tree_num; ++i) {
+            // Clip nodes are 0 and 1, every character is at its own point of the clips
+            trees[i].setTime(0, frame / 60.0 + i * 0.001);
+            trees[i].setTime(1, frame / 60.0 + i * 0.002);
+            trees[i].evaluate();
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    long allocated = allocations - allocations_before;
+
+    std::cout << tree_num << " trees" << (euler_angles ? " with Euler angles: " : ", quaternions only: ")
+              << elapsed.count() / frame_num << " ms per frame, " << 1000.0 * elapsed.count() / frame_num / tree_num
+              << " us per tree, " << allocated << " allocations" << std::endl;
+    return allocated == 0;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    int tree_num = argc > 1 ? std::stoi(argv[1]) : 2000;
+    int frame_num = argc > 2 ? std::stoi(argv[2]) : 20;
+    std::unique_ptr<acclaim::Motion> running = makeClip(148, 9.0);
+    std::unique_ptr<acclaim::Motion> punch_kick = makeClip(450, 4.0);
+    bool passed = run(running.get(), punch_kick.get(), tree_num, frame_num, true);
+    passed = run(running.get(), punch_kick.get(), tree_num, frame_num, false) && passed;
+    if (!passed) std::cerr << "BlendTree::evaluate() allocated after the first call" << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
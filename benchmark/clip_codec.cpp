@@ -0,0 +1,155 @@
+// Writes clips with acclaim::writeClipFile, decodes them with acclaim::ClipDecoder and compares every channel bit
+// for bit. The clips are made to reach every coding: decimal channels (with and without the scale factor) holding
+// escaped values, -0.0, NaNs and infinities, constant channels, raw channels and quaternion tracks.
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include "acclaim/clip_codec.h"
+#include "acclaim/posture.h"
+#include "util/filesystem.h"
+#include "util/helper.h"
+
+namespace {
+constexpr int frame_num = 240;
+constexpr double frame_rate = 120.0;
+// Like the skeleton scale applied to root translations
+constexpr double scale = 1.0 / 0.45;
+
+double fromBits(std::uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+// The double an AMC file holding this value with the given decimals parses to
+double decimal(double value, int decimals) {
+    char text[64];
+    std::snprintf(text, sizeof(text), "%.*f", decimals, value);
+    return std::strtod(text, nullptr);
+}
+
+std::vector<acclaim::Posture> makeClip(bool quaternions, std::mt19937* generator) {
+    std::uniform_real_distribution<double> any(-180.0, 180.0);
+    std::normal_distribution<double> step(0.0, 0.5);
+    // Values a decimal channel cannot code, each must be escaped and come back as it was
+    const double escapes[] = {-0.0,
+                              std::numeric_limits<double>::quiet_NaN(),
+                              -std::numeric_limits<double>::quiet_NaN(),
+                              fromBits(0x7ff8000000000123ull),
+                              std::numeric_limits<double>::infinity(),
+                              -std::numeric_limits<double>::infinity(),
+                              std::numeric_limits<double>::denorm_min(),
+                              1e300,
+                              9007199254740993.0,
+                              0.1 + 0.2};
+    const int escape_num = static_cast<int>(sizeof(escapes) / sizeof(escapes[0]));
+    std::vector<acclaim::Posture> postures(frame_num, acclaim::Posture(4));
+    double walk[3] = {10.0, -20.0, 30.0};
+    for (int i = 0; i < frame_num; ++i) {
+        acclaim::Posture& posture = postures[i];
+        for (double& value : walk) value += step(*generator);
+        // Bone 0: decimal channels, the first with escapes every few frames, and translations times the scale
+        posture.bone_rotations[0] << decimal(walk[0], 2), i % 7 == 3 ? escapes[(i / 7) % escape_num] : 0.0,
+            decimal(walk[1], 6), 0.0;
+        posture.bone_translations[0] << decimal(walk[0], 3) * scale, decimal(walk[1], 3) * scale,
+            decimal(walk[2], 3) * scale, 0.0;
+        // Bone 1: raw channels
+        posture.bone_rotations[1] << any(*generator), any(*generator), any(*generator), any(*generator);
+        posture.bone_translations[1] << any(*generator), fromBits(0x7ff0000000000001ull + i), any(*generator),
+            i % 2 == 0 ? -0.0 : 0.0;
+        // Bone 2: constant channels, including -0.0 and NaN
+        posture.bone_rotations[2] << -0.0, std::numeric_limits<double>::quiet_NaN(), 42.5, 0.1;
+        posture.bone_translations[2] << 0.0, -1.0, std::numeric_limits<double>::infinity(), 1.0;
+        // Bone 3: a decimal channel whose values all need escaping (-0.0 and zero mixed)
+        posture.bone_rotations[3] << (i % 3 == 0 ? -0.0 : 0.0), decimal(walk[2], 1), 0.0, 0.0;
+        posture.bone_translations[3].setZero();
+    }
+    if (quaternions) {
+        for (int i = 0; i < frame_num; ++i) {
+            acclaim::Posture& posture = postures[i];
+            posture.bone_quaternions.assign(4, Eigen::Quaterniond::Identity());
+            for (int j = 0; j < 2; ++j) {
+                const Eigen::Vector4d angles = posture.bone_rotations[j] * (util::PI / 180.0);
+                posture.bone_quaternions[j] = Eigen::AngleAxisd(angles[2], Eigen::Vector3d::UnitZ()) *
+                                              Eigen::AngleAxisd(angles[0], Eigen::Vector3d::UnitX());
+            }
+            // Bone 2 keeps the identity (constant channels), bone 3 holds short decimals
+            posture.bone_quaternions[3].coeffs() << decimal(walk[0] / 180.0, 2), 0.0, -0.0, 0.5;
+        }
+    }
+    return postures;
+}
+
+bool sameChannels(const double* a, const double* b, int count) {
+    return std::memcmp(a, b, count * sizeof(double)) == 0;
+}
+
+// Decode the file and compare it with the postures written, reports the first difference
+bool roundTrip(const std::string& name, const std::vector<acclaim::Posture>& postures) {
+    const util::fs::path file_name = util::fs::temp_directory_path() / ("fk_clip_codec_" + name + ".fkm");
+    bool passed = acclaim::writeClipFile(file_name, postures, frame_rate, scale);
+    acclaim::ClipDecoder decoder;
+    passed = passed && decoder.open(file_name);
+    const int bone_num = postures.empty() ? 0 : static_cast<int>(postures[0].bone_rotations.size());
+    const bool quaternions = !postures.empty() && !postures[0].bone_quaternions.empty();
+    if (passed && (decoder.getFrameNum() != static_cast<int>(postures.size()) || decoder.getBoneNum() != bone_num ||
+                   decoder.getFrameRate() != frame_rate)) {
+        std::cout << name << ": header does not match" << std::endl;
+        passed = false;
+    }
+    acclaim::Posture decoded;
+    for (std::size_t i = 0; passed && i < postures.size(); ++i) {
+        if (!decoder.next(&decoded) || decoded.bone_quaternions.empty() == quaternions) {
+            std::cout << name << ": frame " << i << " cannot be decoded" << std::endl;
+            passed = false;
+            break;
+        }
+        const acclaim::Posture& posture = postures[i];
+        for (int j = 0; passed && j < bone_num; ++j) {
+            const char* channel = nullptr;
+            if (!sameChannels(decoded.bone_rotations[j].data(), posture.bone_rotations[j].data(), 4)) {
+                channel = "rotation";
+            } else if (!sameChannels(decoded.bone_translations[j].data(), posture.bone_translations[j].data(), 4)) {
+                channel = "translation";
+            } else if (quaternions && !sameChannels(decoded.bone_quaternions[j].coeffs().data(),
+                                                    posture.bone_quaternions[j].coeffs().data(), 4)) {
+                channel = "quaternion";
+            }
+            if (channel != nullptr) {
+                std::cout << name << ": frame " << i << " bone " << j << " " << channel << " differs" << std::endl;
+                passed = false;
+            }
+        }
+    }
+    if (passed && decoder.next(&decoded)) {
+        std::cout << name << ": frames after the last one" << std::endl;
+        passed = false;
+    }
+    std::cout << name << ": " << postures.size() << " frames, " << util::fs::file_size(file_name) << " bytes"
+              << (passed ? "" : " FAILED") << std::endl;
+    util::fs::remove(file_name);
+    return passed;
+}
+}  // namespace
+
+int main() {
+    std::mt19937 generator(46);
+    bool passed = roundTrip("euler", makeClip(false, &generator));
+    passed = roundTrip("quaternion", makeClip(true, &generator)) && passed;
+    // Every channel constant, the writer still codes one channel per frame
+    std::vector<acclaim::Posture> still(frame_num, makeClip(true, &generator)[0]);
+    passed = roundTrip("constant", still) && passed;
+    passed = roundTrip("empty", std::vector<acclaim::Posture>()) && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+// Checks the batched Euler to quaternion kernels of every SIMD build against the Eigen::AngleAxisd code they
+// replace. Run it (or ctest) after editing src/util/simd_kernels.inl, it fails if any coefficient is off by more
+// than the bound documented in util/helper.h.
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include "util/helper.h"
+#include "util/simd.h"
+
+namespace {
+// Documented accuracy of util::rotateDegreeZYX / rotateDegreeXYZ batch versions
+constexpr double error_bound = 2e-15;
+constexpr std::size_t random_angles = 100000;
+
+// Largest coefficient difference between kernel output and the Eigen rotation of the same angles
+double maxError(const std::vector<Eigen::Quaterniond>& result, const std::vector<Eigen::Quaterniond>& reference) {
+    double error = 0.0;
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        error = std::max(error, (result[i].coeffs() - reference[i].coeffs()).cwiseAbs().maxCoeff());
+    }
+    return error;
+}
+}  // namespace
+
+int main() {
+    // Multiples of 90 degrees hit every quadrant boundary of the range reduction, the random angles cover
+    // what AMC files contain (a few turns at most)
+    std::vector<Eigen::Vector4d> angles;
+    for (int x = -720; x <= 720; x += 90) {
+        for (int y = -720; y <= 720; y += 90) {
+            for (int z = -720; z <= 720; z += 90) angles.emplace_back(x, y, z, 0.0);
+        }
+    }
+    std::mt19937 generator(20);
+    std::uniform_real_distribution<double> distribution(-720.0, 720.0);
+    for (std::size_t i = 0; i < random_angles; ++i) {
+        angles.emplace_back(distribution(generator), distribution(generator), distribution(generator), 0.0);
+    }
+    const std::size_t n = angles.size();
+    const Eigen::Quaterniond identity = Eigen::Quaterniond::Identity();
+    std::vector<Eigen::Quaterniond> reference_zyx(n, identity), reference_xyz(n, identity), result(n, identity);
+    for (std::size_t i = 0; i < n; ++i) {
+        reference_zyx[i] = util::rotateDegreeZYX(angles[i]);
+        reference_xyz[i] = util::rotateDegreeXYZ(angles[i]);
+    }
+
+    bool passed = true;
+    auto report = [&passed](const char* name, const char* order, double error) {
+        bool ok = error <= error_bound;
+        passed = passed && ok;
+        std::cout << name << " " << order << " max error " << error << (ok ? "" : " FAILED") << std::endl;
+    };
+    // Only the builds this CPU can run, kernels() falls back to narrower ones for builds not compiled in
+    const int widest = static_cast<int>(util::simd::detectInstructionSet());
+    const util::simd::Kernels* previous = nullptr;
+    for (int i = 0; i <= widest; ++i) {
+        const util::simd::Kernels& kernels = util::simd::kernels(static_cast<util::simd::InstructionSet>(i));
+        if (&kernels == previous) continue;
+        previous = &kernels;
+        kernels.eulerToQuaternionZYX(angles[0].data(), util::PI / 180.0, result[0].coeffs().data(), n);
+        report(kernels.name, "ZYX", maxError(result, reference_zyx));
+        kernels.eulerToQuaternionXYZ(angles[0].data(), util::PI / 180.0, result[0].coeffs().data(), n);
+        report(kernels.name, "XYZ", maxError(result, reference_xyz));
+    }
+    // The public batch functions, through the kernels picked at startup
+    util::rotateDegreeZYX(angles.data(), result.data(), n);
+    report("util::rotateDegreeZYX", "batch", maxError(result, reference_zyx));
+    util::rotateDegreeXYZ(angles.data(), result.data(), n);
+    report("util::rotateDegreeXYZ", "batch", maxError(result, reference_xyz));
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,8 @@
+#include <nmmintrin.h>
+
+int main() {
+    long long data[2] = {0, 0};
+    __m128i a = _mm_loadu_si128((const __m128i *)data);
+    __m128i b = _mm_cmpgt_epi64(a, a);
+    return _mm_crc32_u32(0, 0) + _mm_cvtsi128_si32(b);
+}
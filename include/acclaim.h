@@ -1,4 +1,5 @@
 #pragma once
+#include "acclaim/amc_loader.h"
 #include "acclaim/bone.h"
 #include "acclaim/motion.h"
 #include "acclaim/posture.h"
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "posture.h"
+#include "util/filesystem.h"
+
+namespace acclaim {
+class Skeleton;
+// Streaming reader of AMC files, parses one frame at a time. Bone channels are looked up in the skeleton by
+// open(), next() does not touch the skeleton so reading can run on another thread
+class AMCReader final {
+ public:
+    AMCReader() noexcept;
+    AMCReader(const AMCReader &) = delete;
+    AMCReader &operator=(const AMCReader &) = delete;
+    // Skip the header, false if the file cannot be opened
+    bool open(const util::fs::path &file_name, Skeleton *skeleton);
+    // Parse the next frame into posture (resized if needed), false after the last frame or if the file is broken
+    bool next(Posture *posture);
+
+ private:
+    struct BoneChannels final {
+        int idx = 0;
+        // Which of tx ty tz and rx ry rz follow the bone's name
+        bool translation[3] = {false, false, false};
+        bool rotation[3] = {false, false, false};
+    };
+
+    std::ifstream input;
+    std::unordered_map<std::string, BoneChannels> bones;
+    int bone_num = 0;
+    int movable_bones = 0;
+    // Root translations are scaled like the skeleton
+    double scale = 1.0;
+};
+// Parses an AMC file on a background thread and hands frames over in batches, so a clip can be played
+// while the rest of it is still being read
+class AMCLoader final {
+ public:
+    // Start parsing file_name, skeleton is only read before this returns
+    AMCLoader(const util::fs::path &file_name, Skeleton *skeleton, int batch_size = 32) noexcept;
+    AMCLoader(const AMCLoader &) = delete;
+    AMCLoader &operator=(const AMCLoader &) = delete;
+    // Stops parsing if it is still running
+    ~AMCLoader();
+    // Append frames parsed since the last call to postures, returns how many were appended
+    int poll(std::vector<Posture> *postures);
+    // Every frame has been parsed and handed over by poll()
+    bool isDone() const;
+    // The file could not be opened
+    bool hasFailed() const;
+
+ private:
+    void parse(int batch_size);
+
+    AMCReader reader;
+    mutable std::mutex mutex;
+    // Parsed but not yet polled
+    std::vector<Posture> parsed;
+    bool finished = false;
+    bool failed = false;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
+}  // namespace acclaim
@@ -40,6 +40,8 @@ struct Bone final {
     // degree of freedom mask in x, y, z axis (local)
     bool dofrx = false, dofry = false, dofrz = false;  // Rotate
     bool doftx = false, dofty = false, doftz = false;  // Translate
+    // Dropped in the reduced skeleton, its transform is then derived from the parent
+    bool collapsed = false;
     // Rotation matrix from parent to child
     Eigen::Affine3d rot_parent_current = Eigen::Affine3d::Identity();
     // Initial rotation and scaling for bone
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "posture.h"
+#include "util/filesystem.h"
+
+namespace acclaim {
+// Files with this extension are read with ClipDecoder instead of as AMC text
+constexpr const char *clip_file_extension = ".fkm";
+// Lossless binary clip format. Every posture channel (one component of a bone's rotation, translation or
+// quaternion) is coded on its own:
+// - constant channels are stored once in the header
+// - decimal channels hold values that are short decimals (times a factor such as the skeleton scale applied to
+//   root translations), their integer mantissas are predicted from the previous frames and the residual is written
+//   as a zigzag varint. Values that do not fit are escaped and stored raw, so decoding is always bit exact
+// - raw channels store the doubles as they are
+// Write postures captured at frame_rate, scale is tried as the decimal factor. false if the file cannot be written
+bool writeClipFile(const util::fs::path &file_name, const std::vector<Posture> &postures, double frame_rate,
+                   double scale = 1.0);
+// Streaming reader of files written by writeClipFile, decodes one frame at a time
+class ClipDecoder final {
+ public:
+    ClipDecoder() noexcept;
+    ClipDecoder(const ClipDecoder &) = delete;
+    ClipDecoder &operator=(const ClipDecoder &) = delete;
+    // Read the header, false if the file is missing, not a clip file or its counts do not fit the file size
+    bool open(const util::fs::path &file_name);
+    int getFrameNum() const;
+    int getBoneNum() const;
+    double getFrameRate() const;
+    // Decode the next frame into posture (resized if needed), false after the last frame or if the file is broken
+    bool next(Posture *posture);
+
+ private:
+    enum class ChannelMode : std::uint8_t { Constant = 0, Decimal, Raw };
+    struct Channel final {
+        ChannelMode mode = ChannelMode::Constant;
+        // Prediction from the last frame (1) or the last two (2)
+        std::uint8_t order = 1;
+        // value = mantissa / 10^decimals * factor
+        std::uint8_t decimals = 0;
+        double factor = 1.0;
+        double constant = 0.0;
+        // Mantissas of the last two frames
+        std::int64_t previous[2] = {0, 0};
+    };
+    bool readByte(std::uint8_t *byte);
+    bool readVarint(std::uint64_t *value);
+    bool readBytes(void *data, std::size_t size);
+
+    std::ifstream input;
+    std::vector<std::uint8_t> buffer;
+    std::size_t buffer_position = 0, buffer_end = 0;
+    int frame_num = 0;
+    int bone_num = 0;
+    double frame_rate = 120.0;
+    bool quaternions = false;
+    int decoded_frames = 0;
+    std::vector<Channel> channels;
+};
+}  // namespace acclaim
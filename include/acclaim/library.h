@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "motion.h"
+#include "util/filesystem.h"
+
+namespace acclaim {
+// Metadata of an AMC file, kept in the library index so that scanning does not parse unchanged files
+struct ClipInfo final {
+    // Path relative to the library root without extension, such as "01/01_01"
+    std::string name;
+    util::fs::path amc_file;
+    // ASF file the clip is loaded with, from the same directory
+    util::fs::path skeleton_file;
+    // FNV-1a hash of the ASF file, clips with the same hash share a skeleton
+    std::uint64_t skeleton_hash = 0;
+    int frame_num = 0;
+    // In seconds at the default 120 Hz (AMC files do not store the capture rate)
+    double duration = 0.0;
+    // Size and modification time of the AMC file when its metadata was read
+    std::uint64_t file_size = 0;
+    std::int64_t modified_time = 0;
+};
+// Cache activity since the library was created
+struct MotionLibraryStatistics final {
+    // Requests served from the cache
+    std::size_t hits = 0;
+    // Clips read from disk, including reloads
+    std::size_t loads = 0;
+    // Clips read again after they were evicted
+    std::size_t reloads = 0;
+    std::size_t evictions = 0;
+};
+// All AMC files under a directory tree. Metadata lives in an on-disk index, clips are loaded on demand and kept
+// in a least recently used cache bounded by a byte budget.
+class MotionLibrary final {
+ public:
+    explicit MotionLibrary(std::size_t byte_budget = std::size_t(256) << 20, double skeleton_scale = 0.2) noexcept;
+    MotionLibrary(const MotionLibrary &) = delete;
+    MotionLibrary &operator=(const MotionLibrary &) = delete;
+    // Find every AMC file under root (with an ASF file in its directory). Metadata of files unchanged since
+    // index_file was written is taken from it, the others are read (in parallel) and the index is rewritten.
+    // Replaces the clip list and empties the cache, returns the number of clips
+    int scan(const util::fs::path &root, const util::fs::path &index_file);
+    int getClipNum() const;
+    const ClipInfo &getClipInfo(int clip_idx) const;
+    // get index of a clip by name, -1 if not found
+    int findClip(const std::string &name) const;
+    // get a clip, loading it (and evicting least recently used ones beyond the budget) if it is not cached.
+    // Evicted clips stay alive as long as callers hold them. nullptr if the file cannot be read
+    std::shared_ptr<Motion> getMotion(int clip_idx);
+    std::size_t getByteBudget() const;
+    // Change the budget, evicting clips if needed
+    void setByteBudget(std::size_t byte_budget);
+    // Quantize clips as they are loaded (see Motion::quantize()) so several times more fit the budget,
+    // clips already cached are not changed
+    void setQuantized(bool quantized);
+    // get approximate memory of the cached clips
+    std::size_t getCachedBytes() const;
+    const MotionLibraryStatistics &getStatistics() const;
+
+ private:
+    struct CachedClip final {
+        std::shared_ptr<Motion> motion;
+        std::size_t bytes = 0;
+        // Position in the recently used list, valid while motion is set
+        std::list<int>::iterator position;
+        bool evicted = false;
+    };
+    // Evict least recently used clips until the cache fits the budget, the most recent one always stays
+    void evict();
+
+    std::size_t byte_budget;
+    double skeleton_scale;
+    bool quantized = false;
+    std::vector<ClipInfo> clips;
+    // Parsed ASF files by hash, loaded clips get copies
+    std::unordered_map<std::uint64_t, std::unique_ptr<Skeleton>> skeletons;
+    std::vector<CachedClip> cache;
+    // Most recently used first
+    std::list<int> recently_used;
+    std::size_t cached_bytes = 0;
+    MotionLibraryStatistics statistics;
+};
+}  // namespace acclaim
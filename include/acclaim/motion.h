@@ -1,11 +1,19 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <vector>
 
 #include "Eigen/Core"
 
 #include "posture.h"
+#include "simulation/filter.h"
+#include "simulation/keyframe_compression.h"
+#include "simulation/kinematics.h"
+#include "simulation/lod.h"
+#include "simulation/pose.h"
+#include "simulation/resample.h"
+#include "simulation/root_motion.h"
 #include "skeleton.h"
 #include "util/filesystem.h"
 
@@ -14,6 +22,7 @@ namespace acclaim {
 class Motion final {
  public:
     Motion(const util::fs::path &amc_file, std::unique_ptr<Skeleton> &&skeleton) noexcept;
+    Motion(std::vector<Posture> &&postures, std::unique_ptr<Skeleton> &&skeleton, double frame_rate) noexcept;
     Motion() noexcept;
     Motion(const Motion &) noexcept;
     Motion(Motion &&) noexcept;
@@ -27,15 +36,95 @@ class Motion final {
     const std::unique_ptr<Skeleton> &getSkeleton() const;
     // get total frame of the motion
     int getFrameNum() const;
+    // get the posture of specific frame, time warped postures are computed on demand and
+    // the reference stays valid until a few other frames are requested
+    const Posture &getPosture(int frame_idx) const;
+    // get capture rate in frames per second
+    double getFrameRate() const;
+    // AMC files do not store the capture rate, set it if the clip is not captured at 120 Hz
+    void setFrameRate(double frame_rate);
+    // get length of the clip in seconds
+    double getDuration() const;
+    // get approximate memory held by the postures (the skeleton is not counted)
+    std::size_t getByteSize() const;
     // Forward kinematics
     void setBoneTransform(int frame_idx);
-    // Time warpping
+    // Forward kinematics at any time (in seconds, clamped to the clip), interpolating neighbouring frames.
+    // Does nothing while the clip has no frames
+    void sample(double seconds);
+    // get how often forward kinematics runs (every n-th frame)
+    int getUpdateInterval() const;
+    // Run forward kinematics every n-th frame only and interpolate bone transforms in between
+    void setUpdateInterval(int interval);
+    // Apply level of detail (skeleton reduction and update interval) picked for this instance
+    void setLOD(const kinematics::LODSelection &lod);
+    // Resample the (time warped) clip to another frame rate, the result owns a copy of the skeleton
+    Motion resample(const kinematics::ResampleOptions &options) const;
+    // Low-pass filter the (time warped) clip, the result owns a copy of the skeleton
+    Motion filter(const kinematics::FilterOptions &options) const;
+    // Filter into an existing clip and keep its skeleton (which must match this one),
+    // cheap enough to re-run while tuning filter parameters
+    void filter(const kinematics::FilterOptions &options, Motion *filtered) const;
+    // Copy of the (time warped) clip playing in place, its root motion goes to trajectory.
+    // Instances sharing the copy (and its kinematics::RootRelativePoseCache) only differ by the path they follow
+    Motion extractRootMotion(const kinematics::RootMotionOptions &options,
+                             kinematics::RootTrajectory *trajectory) const;
+    // Reduce the (time warped) clip to key frames within a joint position error bound,
+    // CompressedMotion::decode() gives the postures back
+    kinematics::CompressedMotion compress(const kinematics::CompressionOptions &options) const;
+    // Time warpping, replaces the current warp and takes effect on the next setBoneTransform().
+    // Nothing is recomputed here so it is cheap enough to call while dragging a slider
     void timeWarper(int oldframe, int newframe);
+    // Install a custom time map (warped frame -> source frame) such as a kinematics::PiecewiseTimeMap,
+    // empty function removes warping
+    void setTimeMap(kinematics::TimeMap map);
     // read motion data from file
     bool readAMCFile(const util::fs::path &file_name);
+    // read motion data written by writeClipFile(), frames are decoded one by one straight into the clip.
+    // The constructor picks this for files with clip_file_extension
+    bool readClipFile(const util::fs::path &file_name);
+    // write the postures losslessly in the binary clip format (see clip_codec.h), much smaller than AMC text
+    bool writeClipFile(const util::fs::path &file_name) const;
+    // Add frames at the end of the clip, e.g. handed over by an AMCLoader while the file is read
+    void appendPostures(const std::vector<Posture> &more);
+    // Keep the postures as 16-bit words only (see kinematics::QuantizedPostures), several times smaller.
+    // Frames are dequantized on demand and forward kinematics reads the words directly
+    void quantize();
+    // Go back to full precision postures (the quantization error stays)
+    void dequantize();
+    bool isQuantized() const;
+    // get the largest joint position error of the quantized postures, 0 if not quantized
+    double getQuantizationError() const;
 
  private:
+    // Solve forward kinematics of a single frame, respecting the skeleton's level of detail
+    void solveFrame(int frame_idx);
+    void solvePosture(const Posture &posture);
+    // Drop warped postures and solved key frames
+    void clearCache();
+    // Postures of every source frame, dequantized into buffer if the clip is quantized
+    const std::vector<Posture> &storedPostures(std::vector<Posture> *buffer) const;
+    // Quantized counterpart of kinematics::warpPostureQuaternion()
+    void warpQuantized(double source_frame, Posture *posture) const;
+
     std::unique_ptr<Skeleton> skeleton;
     std::vector<Posture> postures;
+    // Replaces postures once quantize() is called
+    kinematics::QuantizedPostures quantized;
+    // CMU motion capture data is recorded at 120 Hz
+    double frame_rate = 120.0;
+    // Interpolated posture of the last sample()
+    Posture sampled_posture;
+    kinematics::TimeMap time_map;
+    // Recently warped postures, frame i goes to slot i % warp_cache_size, -1 means empty
+    static constexpr int warp_cache_size = 4;
+    mutable std::array<int, warp_cache_size> warped_frames = {-1, -1, -1, -1};
+    mutable std::array<Posture, warp_cache_size> warped_postures;
+    // Neighbouring frames when interpolating quantized frames
+    mutable std::array<Posture, 2> dequantized_postures;
+    int update_interval = 1;
+    // Solved key frames for interpolated updates, -1 means empty
+    std::array<int, 2> key_frames = {-1, -1};
+    std::array<kinematics::SkeletonPose, 2> key_poses;
 };
 }  // namespace acclaim
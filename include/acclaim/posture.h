@@ -21,6 +21,11 @@ struct Posture final {
 
     std::vector<Eigen::Vector4d> bone_rotations;
     std::vector<Eigen::Vector4d> bone_translations;
+    // Optional quaternion track, forward kinematics uses it instead of bone_rotations when it is not empty.
+    // Normally the same rotation as util::rotateDegreeZYX(bone_rotations[i]). Postures made for forward kinematics
+    // only (euler_angles = false in kinematics::interpolatePosture, BlendTree, ResampleOptions or FilterOptions)
+    // keep bone_rotations of a source frame instead, so read this track first when it is present
+    std::vector<Eigen::Quaterniond> bone_quaternions;
 };
 }  // namespace acclaim
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(acclaim::Posture)
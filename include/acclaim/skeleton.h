@@ -39,6 +39,15 @@ class Skeleton final {
     void setModelMatrices();
     // render the bone
     void render(graphics::Program *program);
+    // Collapse short leaf chains (fingers, thumbs, toes) whose total length is below
+    // length_ratio * (longest bone length) into their parents for the reduced skeleton
+    void generateReducedSkeleton(const double length_ratio = 0.2);
+    // get total bones kept in the reduced skeleton
+    int getReducedBoneNum() const;
+    // get current level of detail, 0 = full skeleton, 1 = reduced skeleton
+    int getLODLevel() const;
+    // set level of detail used by forward kinematics and rendering
+    void setLODLevel(const int level);
 
  private:
     bool readASFFile(const util::fs::path &file_name);
@@ -65,6 +74,7 @@ class Skeleton final {
 
     double scale = 0.2;
     int movableBones = 1;
+    int lod_level = 0;
     std::vector<Bone> bones = std::vector<Bone>(1);
     std::vector<graphics::Cylinder> bone_graphics;
 };
@@ -13,15 +13,19 @@ namespace graphics {
 class Shader final {
  public:
     Shader(util::fs::path shader, GLenum shaderType);
+    // Compile source already read with readSource()
+    Shader(GLenum shaderType, const std::string& source);
     Shader(const Shader&) = delete;
     Shader& operator=(const Shader&) = delete;
     operator GLuint() const { return id; }
     ~Shader();
 
     GLuint getID() const;
+    // Read a shader file, this does not touch OpenGL so it can run on any thread
+    static std::string readSource(const util::fs::path& filePath);
 
  private:
-    std::string loadFromFile(util::fs::path filename);
+    void compile(const std::string& shaderCode);
     GLuint id;
 };
 
@@ -43,6 +47,12 @@ class Program final {
         this->link();
     }
 
+    // Link a vertex and a fragment shader through an on-disk cache of program binaries. A binary in cacheFolder
+    // matching the sources and the GL driver is loaded directly, otherwise (or if the driver rejects it) the sources
+    // are compiled and linked and the binary is written back. Returns true if the cached binary was used
+    bool linkCached(const util::fs::path& cacheFolder, const std::string& vertexSource,
+                    const std::string& fragmentSource);
+
     GLuint getID() const;
     int getUniformLocation(const char* name) const;
     void use() const;
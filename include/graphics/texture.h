@@ -1,5 +1,7 @@
 #pragma once
 #include <array>
+#include <cstdlib>
+#include <memory>
 
 #include "Eigen/Dense"
 #include "glad/gl.h"
@@ -8,6 +10,15 @@
 #include "util/types.h"
 
 namespace graphics {
+// Pixels decoded on the CPU. Decoding does not touch OpenGL so it can run on any thread, the textures
+// below upload it on the context thread
+struct Image final {
+    int width = 0, height = 0, nChannels = 0;
+    std::unique_ptr<unsigned char, void (*)(void*)> data{nullptr, std::free};
+};
+// Decode an image file, flip puts the first row at the bottom (texture origin of OpenGL).
+// data is empty if the file cannot be read
+Image loadImage(const util::fs::path& filePath, bool flip);
 
 class TextureBase {
  public:
@@ -30,9 +41,11 @@ class Texture final : public TextureBase {
  public:
     explicit Texture(const char* fileName);
     explicit Texture(util::fs::path filePath);
+    // Upload an image decoded with loadImage(filePath, true)
+    explicit Texture(const Image& image);
 
  private:
-    void loadTexture(const char* fileName);
+    void loadTexture(const Image& image);
 };
 
 class ShadowMapTexture final : public TextureBase {
@@ -54,8 +67,10 @@ class CubeTexture final : public TextureBase {
  public:
     explicit CubeTexture(const std::array<const char*, 6>& fileName);
     explicit CubeTexture(const std::array<util::fs::path, 6>& filePath);
+    // Upload faces decoded with loadImage(filePath, false)
+    explicit CubeTexture(const std::array<Image, 6>& images);
 
  private:
-    void loadTexture(const std::array<const char*, 6>& fileName);
+    void loadTexture(const std::array<Image, 6>& images);
 };
 }  // namespace graphics
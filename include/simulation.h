@@ -1,3 +1,18 @@
 #pragma once
+#include "simulation/alignment.h"
 #include "simulation/ball.h"
+#include "simulation/blend_tree.h"
+#include "simulation/features.h"
+#include "simulation/filter.h"
+#include "simulation/keyframe_compression.h"
 #include "simulation/kinematics.h"
+#include "simulation/lod.h"
+#include "simulation/motion_graph.h"
+#include "simulation/motion_matching.h"
+#include "simulation/pose.h"
+#include "simulation/pose_cache.h"
+#include "simulation/quantization.h"
+#include "simulation/resample.h"
+#include "simulation/root_motion.h"
+#include "simulation/time_map.h"
+#include "simulation/trajectory_index.h"
@@ -0,0 +1,41 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+#include "simulation/features.h"
+#include "simulation/time_map.h"
+
+namespace acclaim {
+class Motion;
+}  // namespace acclaim
+namespace kinematics {
+// Dynamic time warping parameters, the coarsest pass is banded and finer passes only search around the
+// path of the previous one, so the cost is linear in clip length
+struct AlignmentOptions final {
+    // Sakoe-Chiba band of the coarsest pass, as a fraction of the clip length
+    double band_ratio = 0.1;
+    // Frames searched on both sides of the projected path at each finer pass
+    int radius = 8;
+    // Stop coarsening when a clip gets this short
+    int coarsest_frames = 128;
+    // Path simplification tolerance (in frames) when picking keyframes
+    double keyframe_tolerance = 2.0;
+};
+// Frame keyframe_old of the aligned motion should be moved to frame keyframe_new of the reference,
+// same meaning as the arguments of acclaim::Motion::timeWarper()
+struct KeyframePair final {
+    int keyframe_old;
+    int keyframe_new;
+};
+// Warping path between two feature sequences as (reference frame, motion frame) from (0, 0) to the last frames
+std::vector<std::pair<int, int>> alignFeatures(const MotionFeatures& reference, const MotionFeatures& motion,
+                                               const AlignmentOptions& options);
+// Simplify a warping path into increasing keyframe pairs (first and last frames included)
+std::vector<KeyframePair> pathToKeyframes(const std::vector<std::pair<int, int>>& path, double tolerance);
+// Align motion to reference (same skeleton) by their joint positions
+std::vector<KeyframePair> alignMotions(acclaim::Motion* reference, acclaim::Motion* motion,
+                                       const AlignmentOptions& options);
+// Time map through all keyframe pairs, for acclaim::Motion::setTimeMap()
+PiecewiseTimeMap makeTimeMap(const std::vector<KeyframePair>& keyframes,
+                             PiecewiseTimeMap::Interpolation interpolation = PiecewiseTimeMap::Interpolation::Linear);
+}  // namespace kinematics
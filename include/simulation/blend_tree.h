@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include "acclaim/posture.h"
+#include "util/types.h"
+
+namespace acclaim {
+class Motion;
+class Skeleton;
+}  // namespace acclaim
+namespace kinematics {
+// Per-bone weights, 1 for the named bone and every bone below it, 0 elsewhere
+std::vector<double> subtreeMask(acclaim::Skeleton* skeleton, const std::string& bone_name);
+// Layers several motions into one posture, e.g. an upper body punch on top of a running lower body.
+// Nodes refer to their inputs by index, inputs must be added before the nodes using them and the last node
+// added is the output. Every node owns its output posture so evaluate() does not allocate after the first call.
+// Nodes with invalid inputs are not added (the add functions return -1), clip nodes hold their last pose while
+// their clip has no frames.
+class BlendTree final {
+ public:
+    // euler_angles: also fill bone_rotations of the result. Without it they are not kept up to date and only the
+    // quaternion track (all forward kinematics reads) is the blended pose
+    explicit BlendTree(int bone_num, bool euler_angles = true) noexcept;
+    // Sample a motion at the time set by setTime(), the time wraps around the clip. Its postures must have bone_num
+    // bones, otherwise the node keeps the rest pose
+    int addClip(acclaim::Motion* motion);
+    // Blend from -> to by weight, bone_mask (one weight per bone, optional) scales the weight of each bone.
+    // Returns -1 if an input is not an existing node or the mask size is wrong
+    int addBlend(int from, int to, double weight, const std::vector<double>& bone_mask = {});
+    // Add the difference between layer and the layer clip's posture at reference_seconds on top of base.
+    // base must be an existing node and layer a clip node, returns -1 otherwise.
+    int addAdditive(int base, int layer, double reference_seconds, double weight = 1.0);
+    // set time (in seconds) of a clip node
+    void setTime(int node_idx, double seconds);
+    // set weight of a blend or additive node
+    void setWeight(int node_idx, double weight);
+    // get number of nodes
+    int getNodeNum() const;
+    // Evaluate every node, the result carries a quaternion track for forward kinematics. The rest pose (identity
+    // rotations, zero translations) while the tree has no nodes
+    const acclaim::Posture& evaluate();
+
+ private:
+    enum class NodeType { Clip, Blend, Additive };
+    struct Node {
+        NodeType type = NodeType::Clip;
+        // Clip
+        acclaim::Motion* motion = nullptr;
+        double time = 0.0;
+        // Blend and additive
+        int inputs[2] = {-1, -1};
+        double weight = 1.0;
+        std::vector<double> mask;
+        // Additive, inverse rotations and translations of the reference posture
+        std::vector<Eigen::Quaterniond> reference_rotations;
+        std::vector<Eigen::Vector4d> reference_translations;
+        acclaim::Posture output;
+    };
+    // Sample the motion at seconds (wrapped) into posture
+    static void sampleClip(acclaim::Motion* motion, double seconds, acclaim::Posture* posture);
+    bool isNode(int node_idx) const;
+    int addNode(Node&& node);
+    void evaluateBlend(Node* node);
+    void evaluateAdditive(Node* node);
+
+    int bone_num;
+    bool euler_angles;
+    std::vector<Node> nodes;
+    // Output of an empty tree and reference of additive layers without frames
+    acclaim::Posture rest_pose;
+    // Scratch space, sized once
+    std::vector<double> weights;
+    std::vector<Eigen::Quaterniond> identity;
+    std::vector<Eigen::Quaterniond> delta;
+    std::vector<Eigen::Quaterniond> scaled_delta;
+};
+}  // namespace kinematics
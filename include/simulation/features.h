@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace acclaim {
+class Motion;
+class Skeleton;
+}  // namespace acclaim
+namespace kinematics {
+// Fixed size feature vector per frame, stored frame after frame
+struct MotionFeatures final {
+    int frame_num = 0;
+    int dimension = 0;
+    std::vector<double> values;
+    // get the feature vector of a frame (dimension doubles)
+    const double* getFrame(int frame_idx) const;
+};
+// Indices of the named bones in the skeleton of a clip, false (and a message naming the clip) if one is missing
+bool findBones(acclaim::Skeleton* skeleton, const std::vector<std::string>& names, const std::string& clip_name,
+               std::vector<int>* bones);
+// Joint positions relative to the root from forward kinematics, 4 doubles per bone (w = 0).
+// Solves every frame on the motion's own skeleton.
+void extractJointPositions(acclaim::Motion* motion, MotionFeatures* features);
+// Positions and velocities (units per second, from the previous frame) of the given bones in the character's
+// frame: origin at the root, rotated by the root's heading around y. 6 doubles per bone, comparable across
+// clips no matter where the character stands or which way it faces.
+void extractPoseFeatures(acclaim::Motion* motion, const std::vector<int>& bones, MotionFeatures* features);
+// Per dimension transform (feature - means) * scales for features of extractPoseFeatures. Positions and velocities
+// are scaled to unit (average) standard deviation over all frames, then weighted
+void poseFeatureScales(const MotionFeatures& features, double position_weight, double velocity_weight,
+                       std::vector<double>* means, std::vector<double>* scales);
+// Hash of what the features of a clip are computed from: frame count, bone lengths and directions of its skeleton
+// and every (time warped) posture. Saved next to derived data to tell whether the clip has changed since
+std::uint64_t motionFingerprint(const acclaim::Motion* motion);
+// Halve the frame rate by averaging pairs of frames (the last odd frame is kept)
+void downsampleFeatures(const MotionFeatures& features, MotionFeatures* coarse);
+}  // namespace kinematics
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+
+#include "acclaim/posture.h"
+
+namespace kinematics {
+enum class FilterType { Gaussian, Butterworth };
+// Options for low-pass filtering a whole clip
+struct FilterOptions final {
+    FilterType type = FilterType::Gaussian;
+    // Standard deviation of the Gaussian kernel in seconds
+    double sigma = 0.025;
+    // Cutoff frequency of the Butterworth filter in Hz, it runs forward and backward so there is no lag
+    double cutoff = 6.0;
+    bool filter_translations = true;
+    // Rotations are filtered as quaternion components (kept on one hemisphere along time) and renormalized
+    bool filter_rotations = true;
+    // Also fill bone_rotations (Euler angles) of the output. Without them the output keeps the unfiltered angles,
+    // fine for playback (forward kinematics reads the quaternion track) but not for editing or time warping Euler
+    // angles
+    bool euler_angles = true;
+};
+// Normalized taps of a Gaussian FIR filter (standard deviation in frames), a single tap for sigma below a frame
+std::vector<double> gaussianTaps(double sigma_frames);
+// Filter postures captured at frame_rate into filtered (resized, existing storage is reused).
+// The clip is transposed so every channel (a translation axis or a quaternion component of one bone) is a
+// contiguous track, channels are split across util::ThreadPool::global().
+// Output postures carry quaternion tracks.
+void filterPostures(const std::vector<acclaim::Posture>& postures, double frame_rate, const FilterOptions& options,
+                    std::vector<acclaim::Posture>* filtered);
+}  // namespace kinematics
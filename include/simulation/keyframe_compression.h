@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "acclaim/posture.h"
+
+namespace acclaim {
+class Skeleton;
+}  // namespace acclaim
+namespace kinematics {
+// Options for lossy keyframe reduction
+struct CompressionOptions final {
+    // Largest joint position error allowed (same units as acclaim::Bone::end_position), checked with forward
+    // kinematics over every frame
+    double max_error = 0.01;
+    // Compression passes searching the loosest channel tolerances that pass the check,
+    // every frame is kept if none does
+    int max_iterations = 6;
+};
+// A clip reduced to key frames. Every bone has a rotation track (Euler angles, or quaternion components if the
+// source postures carry quaternion tracks) and a translation track, each keeps only the frames needed to stay
+// within the error bound. Tracks are cubic Hermite splines through their keys with Catmull-Rom tangents, keys
+// are added where the spline strays furthest from the source until every channel is within its tolerance.
+// Channel tolerances come from the error bound and how far each bone reaches down its chain.
+class CompressedMotion final {
+ public:
+    CompressedMotion() noexcept;
+    // Compress postures captured at frame_rate, forward kinematics for the error check runs on skeleton
+    CompressedMotion(acclaim::Skeleton* skeleton, const std::vector<acclaim::Posture>& postures, double frame_rate,
+                     const CompressionOptions& options) noexcept;
+    int getFrameNum() const;
+    double getFrameRate() const;
+    // get number of keys over all tracks
+    std::size_t getKeyNum() const;
+    // get bytes of keys and key values
+    std::size_t getByteSize() const;
+    // get the largest joint position error measured over every frame
+    double getError() const;
+    // Posture at any frame, fractional frames interpolate along the splines, clamped to the clip
+    void sample(double frame, acclaim::Posture* posture) const;
+    // Postures of every frame (resized, existing storage is reused), walks the keys in order instead of searching
+    void decode(std::vector<acclaim::Posture>* postures) const;
+
+ private:
+    struct Track final {
+        int channels = 3;
+        std::vector<std::int32_t> frames;
+        // channels floats per key
+        std::vector<float> values;
+        // Value at frame, segment is the key at or before it
+        void evaluate(std::size_t segment, double frame, double* out) const;
+        // Add keys until every channel of every frame is within tolerance of samples (frame major)
+        void fit(const std::vector<double>& samples, int channels, double tolerance);
+    };
+    void setBone(int bone_idx, const double* rotation, const double* translation, acclaim::Posture* posture) const;
+
+    int frame_num = 0;
+    double frame_rate = 120.0;
+    // Rotations are quaternions (x y z w) instead of Euler angles
+    bool quaternions = false;
+    std::vector<Track> rotation_tracks;
+    std::vector<Track> translation_tracks;
+    double error = 0.0;
+};
+}  // namespace kinematics
@@ -2,13 +2,46 @@
 #include <vector>
 
 #include "acclaim/posture.h"
+#include "simulation/quantization.h"
+#include "simulation/time_map.h"
 
 namespace acclaim {
 struct Bone;
-}
+class Skeleton;
+}  // namespace acclaim
 namespace kinematics {
 // Apply forward kinematics to skeleton
 void forwardSolver(const acclaim::Posture& posture, acclaim::Bone* bone);
+// Apply forward kinematics to the reduced skeleton, collapsed bones follow their parents rigidly
+void forwardSolverReduced(const acclaim::Posture& posture, acclaim::Bone* bone);
+// Apply forward kinematics to the whole skeleton at once with the runtime dispatched SIMD kernels,
+// same result as forwardSolver()
+void forwardSolverBatch(const acclaim::Posture& posture, acclaim::Skeleton* skeleton);
+// Same as forwardSolverBatch() on a quantized frame, the words are dequantized straight into the solver's buffers
+void forwardSolverQuantized(const QuantizedPostures& postures, int frame_idx, acclaim::Skeleton* skeleton);
+// Time map of timeWarper(): frames up to keyframe_new are stretched so that keyframe_old lands on keyframe_new,
+// later frames keep their original spacing
+TimeMap makeTimeWarp(int keyframe_old, int keyframe_new);
+// Blend two postures into posture, translations linearly and rotations as quaternions (nlerp) into
+// posture->bone_quaternions. posture->bone_rotations are the Euler angles of the blended rotations. Without
+// euler_angles they are copied from `from` and do not match the blend, only for results that go straight to
+// forward kinematics
+void interpolatePosture(const acclaim::Posture& from, const acclaim::Posture& to, double t,
+                        acclaim::Posture* posture, bool euler_angles = true);
+// Interpolate the posture at a fractional source frame (clamped to the clip) into posture. Postures carrying a
+// quaternion track are blended like warpPostureQuaternion()
+void warpPosture(const std::vector<acclaim::Posture>& postures, double source_frame, acclaim::Posture* posture);
+// Same as warpPosture() but rotations are blended as quaternions (nlerp) into posture->bone_quaternions,
+// which forward kinematics uses directly. posture->bone_rotations hold the same rotations as Euler angles
+void warpPostureQuaternion(const std::vector<acclaim::Posture>& postures, double source_frame,
+                           acclaim::Posture* posture);
+// Warp every frame through time_map like warpPostureQuaternion() into warped, which is resized to the clip and
+// reuses its storage. Frames are split across util::ThreadPool::global().
+void warpPostures(const std::vector<acclaim::Posture>& postures, const TimeMap& time_map,
+                  std::vector<acclaim::Posture>* warped);
+// Same as above, the source frames are evaluated in one sweep over the keys
+void warpPostures(const std::vector<acclaim::Posture>& postures, const PiecewiseTimeMap& time_map,
+                  std::vector<acclaim::Posture>* warped);
 // Apply time warping to motion
 std::vector<acclaim::Posture> timeWarper(const std::vector<acclaim::Posture>& postures, int keyframe_old,
                                          int keyframe_new);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Eigen/Core"
+
+namespace acclaim {
+class Skeleton;
+}
+namespace kinematics {
+// Animation level of detail picked for one character instance
+struct LODSelection final {
+    // 0 = full skeleton, 1 = reduced skeleton (leaf chains collapsed)
+    int level = 0;
+    // Run forward kinematics every n-th frame and interpolate in between
+    int update_interval = 1;
+};
+// Screen-space thresholds (in pixels of projected skeleton height) for choosing LOD
+struct LODPolicy final {
+    // Below this size the reduced skeleton is used
+    double reduced_skeleton_below = 240.0;
+    // Below these sizes forward kinematics runs every 2nd / 4th frame
+    double half_rate_below = 160.0;
+    double quarter_rate_below = 80.0;
+    // Choose LOD for a character covering `screen_size` pixels
+    LODSelection select(double screen_size) const;
+};
+// Projected height (in pixels) of the bounding sphere of the skeleton's current pose
+double screenSpaceSize(acclaim::Skeleton* skeleton, const Eigen::Matrix4f& view, const Eigen::Matrix4f& projection,
+                       int viewport_height);
+}  // namespace kinematics
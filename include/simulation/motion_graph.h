@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "simulation/features.h"
+#include "util/filesystem.h"
+
+namespace acclaim {
+class Motion;
+}  // namespace acclaim
+namespace kinematics {
+// Options for finding transitions between frames
+struct MotionGraphOptions final {
+    // Bones whose positions and velocities are compared (see extractPoseFeatures)
+    std::vector<std::string> bones = {"lfoot", "rfoot", "lhand", "rhand", "head"};
+    // Relative importance of matching positions and velocities (the two terms have unit deviation)
+    double position_weight = 1.0;
+    double velocity_weight = 1.0;
+    // Largest squared feature distance of a transition
+    double threshold = 2.0;
+    // Frames of the same clip closer than this are always similar, they are not transitions
+    int min_separation = 30;
+    // Frames per side of the tiles the distance matrix is computed in, the features of a tile stay in cache
+    int tile_size = 128;
+};
+// Frame pair similar enough to jump between, in both directions since the distance is symmetric
+struct Transition final {
+    std::int32_t from_clip, from_frame;
+    std::int32_t to_clip, to_frame;
+    // Squared feature distance
+    double distance;
+};
+// Finds transition points between all frames of a set of clips for building a motion graph.
+// Features are extracted once per frame, the distance matrix is evaluated tile by tile across
+// util::ThreadPool::global() and only local minima below the threshold are kept and written out,
+// so the full matrix never exists.
+class MotionGraphBuilder final {
+ public:
+    explicit MotionGraphBuilder(const MotionGraphOptions& options = MotionGraphOptions()) noexcept;
+    // Extract features of every frame of the clip (forward kinematics on its skeleton), name identifies the clip
+    // in the output. Returns the clip index or -1 if a bone is missing
+    int addMotion(const std::string& name, acclaim::Motion* motion);
+    int getClipNum() const;
+    // get total frames of all clips
+    int getFrameNum() const;
+    // Write the transitions of every frame pair to a file (see readTransitions), returns how many were found or
+    // -1 if the file cannot be written
+    std::int64_t findTransitions(const util::fs::path& file_name);
+
+ private:
+    // Transitions among rows [row_begin, row_end) and columns [column_begin, column_end) of the matrix
+    void findTileTransitions(const MotionFeatures& normalized, int row_begin, int row_end, int column_begin,
+                             int column_end, std::vector<Transition>* transitions) const;
+
+    MotionGraphOptions options;
+    std::vector<std::string> clip_names;
+    // Clip i owns global frames [clip_offsets[i], clip_offsets[i + 1]), transitions use global frames
+    std::vector<int> clip_offsets = {0};
+    // Clip of every global frame
+    std::vector<int> frame_clips;
+    // Features of every frame, normalized when transitions are searched
+    MotionFeatures features;
+};
+// Read transitions written by MotionGraphBuilder::findTransitions, and the clip names they refer to
+bool readTransitions(const util::fs::path& file_name, std::vector<std::string>* clip_names,
+                     std::vector<Transition>* transitions);
+}  // namespace kinematics
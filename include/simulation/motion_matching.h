@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "simulation/features.h"
+#include "util/filesystem.h"
+
+namespace acclaim {
+class Motion;
+}  // namespace acclaim
+namespace kinematics {
+// Options of a pose database, an index saved with other options is rebuilt
+struct PoseDatabaseOptions final {
+    // Bones whose positions and velocities make up the feature vector (see extractPoseFeatures)
+    std::vector<std::string> bones = {"lfoot", "rfoot", "head"};
+    // Weights of the position and the velocity terms, applied after scaling both to unit deviation
+    double position_weight = 1.0;
+    double velocity_weight = 1.0;
+    // Frames per KD-tree leaf, each leaf is scanned with util::simd::Kernels::squaredDistances
+    int leaf_size = 32;
+};
+// Best frame found by a query
+struct PoseMatch final {
+    int clip = -1;
+    int frame = -1;
+    // Squared distance between the normalized features
+    double distance = std::numeric_limits<double>::infinity();
+};
+// Motion matching database: normalized pose features of every frame of every clip, indexed by a KD-tree
+// so that the best next frame is found without scanning the whole library.
+class PoseDatabase final {
+ public:
+    explicit PoseDatabase(const PoseDatabaseOptions& options = PoseDatabaseOptions()) noexcept;
+    // Extract features of every frame of the clip (forward kinematics on its skeleton), name identifies the clip
+    // in a saved database. Returns the clip index or -1 if a bone is missing. Call build() after adding clips,
+    // queries find nothing until then
+    int addMotion(const std::string& name, acclaim::Motion* motion);
+    // Normalize features of every clip added so far and build the tree, again after adding more clips
+    void build();
+    int getClipNum() const;
+    const std::string& getClipName(int clip_idx) const;
+    // get total frames of all clips
+    int getFrameNum() const;
+    // get length of the feature vector
+    int getDimension() const;
+    // get normalized feature of a frame, a starting point for queries. nullptr until build()
+    const double* getFeature(int clip_idx, int frame_idx) const;
+    // Normalize a feature vector laid out like extractPoseFeatures into the space of the database (centered,
+    // weighted and rotated, so edit raw features and normalize them rather than editing normalized ones)
+    void normalize(const double* feature, double* normalized) const;
+    // Find the frame nearest to a normalized feature. With approximation > 0 the match may be up to
+    // (1 + approximation) times farther than the nearest one, which prunes far more of the tree for queries
+    // that are not close to any frame. clip and frame are -1 if nothing is found (not built, or NaN features)
+    PoseMatch query(const double* feature, double approximation = 0.0) const;
+    // Write features, normalization and tree to a file (native byte order), usually next to the clips
+    bool save(const util::fs::path& file_name) const;
+    // Read a database written by save() from clips, the same clips in the order they were added. Fails if the file
+    // is missing, broken, built with other options or if any clip has changed since (see motionFingerprint)
+    bool load(const util::fs::path& file_name, const std::vector<acclaim::Motion*>& clips);
+
+ private:
+    struct Node final {
+        // Range of tree-ordered frames below this node
+        int begin, end;
+        // Split dimension, -1 for leaves
+        int dimension;
+        int left, right;
+    };
+    // Center, scale and rotate raw_features into features (frame order), with new axes if there are none
+    void normalizeFeatures();
+    // Put features in tree order and fill frame_positions
+    void orderFeatures();
+    int buildNode(int begin, int end);
+    // Indices read by load() are in range: clip offsets increase, tree_frames is a permutation of the frames and
+    // every node covers frames inside its parent with children stored after it
+    bool isIndexValid() const;
+    // Squared distance from the feature to the bounding box of a node
+    double boxDistance(int node_idx, const double* feature) const;
+    // scale: squared (1 + approximation)
+    void searchNode(int node_idx, const double* feature, double scale, PoseMatch* best,
+                    std::vector<double>* distances) const;
+
+    PoseDatabaseOptions options;
+    int dimension = 0;
+    std::vector<std::string> clip_names;
+    std::vector<std::uint64_t> clip_fingerprints;
+    // Global index of the first frame of each clip, and the total at the end
+    std::vector<int> clip_offsets = {0};
+    // Features of every frame as extracted, build() starts from these every time
+    MotionFeatures raw_features;
+    // Normalized features in tree order, empty until build()
+    MotionFeatures features;
+    // Features are centered, scaled and rotated onto their principal axes (dimension * dimension, row major)
+    std::vector<double> means, scales, axes;
+    // Global frame at each tree position and the other way around
+    std::vector<int> tree_frames, frame_positions;
+    std::vector<Node> nodes;
+    // Bounding box of every node's frames, lower corner then upper corner (2 * dimension doubles per node)
+    std::vector<double> bounds;
+};
+}  // namespace kinematics
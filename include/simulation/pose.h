@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include "util/types.h"
+
+namespace acclaim {
+class Skeleton;
+}
+namespace kinematics {
+// Snapshot of the forward kinematics result (global transform) of every bone
+struct SkeletonPose final {
+ public:
+    SkeletonPose() noexcept;
+    explicit SkeletonPose(const std::size_t size) noexcept;
+    // You need this for alignment otherwise it may crash
+    // Ref: https://eigen.tuxfamily.org/dox/group__TopicStructHavingEigenMembers.html
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    // get total bones in the snapshot
+    int getBoneNum() const;
+
+    std::vector<Eigen::Vector4d> start_positions;
+    std::vector<Eigen::Vector4d> end_positions;
+    std::vector<Eigen::Quaterniond> rotations;
+};
+// Copy current bone transforms of the skeleton into pose
+void capturePose(acclaim::Skeleton* skeleton, SkeletonPose* pose);
+// Write pose back to the bones of the skeleton
+void applyPose(const SkeletonPose& pose, acclaim::Skeleton* skeleton);
+// Interpolate two poses (lerp positions, slerp rotations) and write the result to the skeleton
+void blendPose(const SkeletonPose& from, const SkeletonPose& to, double t, acclaim::Skeleton* skeleton);
+}  // namespace kinematics
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include "simulation/pose.h"
+#include "util/types.h"
+
+namespace acclaim {
+class Motion;
+class Skeleton;
+}  // namespace acclaim
+namespace kinematics {
+// Caches forward kinematics of a clip in root-local space, once per frame.
+// Instances playing the same clip with different offsets / phases only pay for
+// applying their root transform to the cached pose instead of solving the hierarchy.
+// For clips playing in place (see acclaim::Motion::extractRootMotion) the instance transform is
+// placement * trajectory.sample(seconds), so instances can also follow the path for any number of loops.
+class RootRelativePoseCache final {
+ public:
+    explicit RootRelativePoseCache(acclaim::Motion* motion) noexcept;
+    RootRelativePoseCache(const RootRelativePoseCache&) = delete;
+    RootRelativePoseCache(RootRelativePoseCache&&) noexcept;
+    // You need this for alignment otherwise it may crash
+    // Ref: https://eigen.tuxfamily.org/dox/group__TopicStructHavingEigenMembers.html
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    RootRelativePoseCache& operator=(const RootRelativePoseCache&) = delete;
+    RootRelativePoseCache& operator=(RootRelativePoseCache&&) noexcept;
+    // get bone transforms of the frame relative to the root bone, solved on first use
+    const SkeletonPose& getPose(int frame_idx);
+    // get the root bone's global transform of the frame
+    const Eigen::Affine3d& getRootTransform(int frame_idx);
+    // Place the cached pose with root transform = instance * (clip root transform of the frame)
+    void apply(int frame_idx, const Eigen::Affine3d& instance, acclaim::Skeleton* skeleton);
+    // Solve every frame up front
+    void build();
+    // Drop cached frames, call this after the clip changes
+    void clear();
+
+ private:
+    void solve(int frame_idx);
+
+    acclaim::Motion* motion;
+    std::vector<bool> cached;
+    std::vector<SkeletonPose> poses;
+    std::vector<Eigen::Affine3d> root_transforms;
+};
+}  // namespace kinematics
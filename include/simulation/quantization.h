@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Eigen/Geometry"
+
+#include "acclaim/posture.h"
+
+namespace acclaim {
+class Skeleton;
+}  // namespace acclaim
+namespace kinematics {
+// Postures stored as 16-bit words. Euler angle and translation channels are quantized over their own range
+// (value = minimum + word * step), channels that never change take no words. Postures carrying quaternion tracks
+// store rotations as the smallest three components (15 bits each, the index of the dropped one in the spare bits).
+// Forward kinematics reads the words directly through forwardSolverQuantized().
+class QuantizedPostures final {
+ public:
+    QuantizedPostures() noexcept;
+    // Quantize postures, the error is measured with forward kinematics on skeleton
+    QuantizedPostures(acclaim::Skeleton* skeleton, const std::vector<acclaim::Posture>& postures) noexcept;
+    int getFrameNum() const;
+    int getBoneNum() const;
+    // get bytes of the quantized words and channel ranges
+    std::size_t getByteSize() const;
+    // get the largest joint position error over every frame against the source postures
+    double getError() const;
+    // Dequantize a frame into posture (resized if needed)
+    void getPosture(int frame_idx, acclaim::Posture* posture) const;
+    // Dequantize a frame for the batched solver: a quaternion (x y z w) and a translation (4 doubles) per bone
+    void dequantize(int frame_idx, double* quaternions, double* translations) const;
+
+ private:
+    struct Channel final {
+        double minimum = 0.0;
+        double step = 0.0;
+        // Word of the channel within a frame, -1 if the channel stays at minimum
+        int offset = -1;
+    };
+    // Euler angles of every bone in degrees, 4 doubles per bone like acclaim::Posture::bone_rotations
+    void dequantizeEuler(const std::uint16_t* frame, double* euler) const;
+    double channelValue(const std::uint16_t* frame, const Channel& channel) const;
+    Eigen::Quaterniond rotation(const std::uint16_t* frame, int bone_idx) const;
+
+    int frame_num = 0;
+    int bone_num = 0;
+    // Rotations are smallest three quaternions instead of Euler angles
+    bool quaternions = false;
+    // Words per frame
+    int stride = 0;
+    // Per bone: 3 rotation channels (Euler angles) then 3 translation channels
+    std::vector<Channel> channels;
+    // Per bone in quaternion mode: first of the 3 words, -1 if the rotation never changes
+    std::vector<int> quaternion_offsets;
+    std::vector<Eigen::Quaterniond> constant_quaternions;
+    std::vector<std::uint16_t> words;
+    double error = 0.0;
+};
+}  // namespace kinematics
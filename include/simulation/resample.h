@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+
+#include "acclaim/posture.h"
+
+namespace kinematics {
+// Options for resampling a clip to another frame rate
+struct ResampleOptions final {
+    // Output frame rate in frames per second
+    double target_rate = 60.0;
+    // When downsampling, average the source frames covered by each output frame (tent filter) instead of
+    // picking the nearest two, which removes motion faster than the output can represent
+    bool anti_aliasing = true;
+    // Also fill bone_rotations (Euler angles) of the output, otherwise each output frame keeps the angles of a
+    // neighbouring source frame next to its resampled quaternion track
+    bool euler_angles = true;
+};
+// Resample postures captured at source_rate into resampled (resized, existing storage is reused).
+// Output postures carry quaternion tracks, frames are split across util::ThreadPool::global().
+void resample(const std::vector<acclaim::Posture>& postures, double source_rate, const ResampleOptions& options,
+              std::vector<acclaim::Posture>* resampled);
+}  // namespace kinematics
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include "acclaim/posture.h"
+#include "util/types.h"
+
+namespace acclaim {
+class Skeleton;
+}  // namespace acclaim
+namespace kinematics {
+// Ground-plane path of a clip's root: position on the floor and heading around the up (y) axis,
+// three doubles per frame instead of a full transform
+struct RootTrajectory final {
+    double frame_rate = 120.0;
+    // x, z and heading (radian, unwrapped so it never jumps by 2 pi) of every frame
+    std::vector<Eigen::Vector3d> samples;
+    int getFrameNum() const;
+    // get the path transform of a frame
+    Eigen::Affine3d getTransform(int frame_idx) const;
+    // get the path transform at any time (seconds), interpolating neighbouring frames.
+    // The path keeps going past the end as if the clip looped, every loop starts where the last one ended
+    Eigen::Affine3d sample(double seconds) const;
+};
+// Options for extracting root motion
+struct RootMotionOptions final {
+    // Standard deviation (seconds) of the Gaussian smoothing the path, faster sway of the gait stays in the clip
+    double smoothing = 0.1;
+};
+// Move root motion of postures (captured at frame_rate) into trajectory. Afterwards the root stays around the
+// origin facing +z with its height and tilt kept, and trajectory.getTransform(i) * (root of frame i) is the
+// original root. Output postures carry quaternion tracks.
+void extractRootMotion(acclaim::Skeleton* skeleton, double frame_rate, const RootMotionOptions& options,
+                       std::vector<acclaim::Posture>* postures, RootTrajectory* trajectory);
+}  // namespace kinematics
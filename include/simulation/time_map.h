@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace kinematics {
+// Maps a frame of the warped motion to a (fractional) frame of the source motion
+using TimeMap = std::function<double(int)>;
+// Monotone time map through any number of (warped frame, source frame) key pairs.
+// Outside the keys frames are shifted with slope 1, without keys it is the identity.
+class PiecewiseTimeMap final {
+ public:
+    enum class Interpolation {
+        Linear,
+        // Monotone cubic Hermite, smooth speed changes at the keys
+        Cubic
+    };
+    explicit PiecewiseTimeMap(Interpolation interpolation = Interpolation::Linear) noexcept;
+    // Add a key, both frames must keep increasing with the other keys (the key is rejected otherwise).
+    // A key at the same warped frame replaces the old one.
+    bool addKey(double warped_frame, double source_frame);
+    // Remove all keys
+    void clear();
+    // get number of keys
+    int getKeyNum() const;
+    Interpolation getInterpolation() const;
+    void setInterpolation(Interpolation interpolation);
+    // Source frame of the warped frame, O(log keys)
+    double evaluate(double warped_frame) const;
+    double operator()(int warped_frame) const;
+    // Evaluate warped frames sorted in ascending order, O(n + keys)
+    void evaluateSorted(const double* warped_frames, double* source_frames, std::size_t n) const;
+
+ private:
+    // Source frame of the warped frame inside segment i (between key i and i + 1), or extrapolated for
+    // i = -1 or the last key
+    double evaluateSegment(int i, double warped_frame) const;
+    // Recompute tangents for cubic interpolation
+    void updateTangents();
+
+    Interpolation interpolation;
+    std::vector<double> warped_keys;
+    std::vector<double> source_keys;
+    // Slope of the source frame at each key
+    std::vector<double> tangents;
+};
+}  // namespace kinematics
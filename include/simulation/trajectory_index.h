@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+namespace acclaim {
+class Motion;
+}  // namespace acclaim
+namespace kinematics {
+struct TrajectoryIndexOptions final {
+    // Bones whose end positions are indexed, empty indexes every bone of the first clip
+    std::vector<std::string> bones;
+    // Frames per time segment, every segment is bounded by one box
+    int segment_frames = 8;
+    // Segments per tree leaf
+    int leaf_size = 4;
+};
+// Frame whose bone path to the next frame touches the queried region
+struct TrajectoryHit final {
+    int clip = -1;
+    int frame = -1;
+    // Closest distance of the path to the queried point, 0 for box queries
+    double distance = 0.0;
+};
+// World space trajectories of bones over a set of clips, answering region queries without running forward
+// kinematics again. Each clip's trajectory is cut into segments of a few frames and every tracked bone gets a
+// bounding volume hierarchy over the boxes of its segments, so a query visits about log(segments) nodes plus the
+// segments it hits. Queries test the straight path between consecutive frames, a fast bone passing through a small
+// region between two samples is still found.
+class TrajectoryIndex final {
+ public:
+    explicit TrajectoryIndex(const TrajectoryIndexOptions& options = TrajectoryIndexOptions()) noexcept;
+    // Run forward kinematics over every frame of the clip (on its skeleton) and keep the bone positions,
+    // name identifies the clip. Returns the clip index or -1 if a bone is missing. Queries find nothing until the
+    // next build()
+    int addMotion(const std::string& name, acclaim::Motion* motion);
+    // Build the hierarchies, call after adding clips and before querying (again after adding more)
+    void build();
+    int getClipNum() const;
+    const std::string& getClipName(int clip_idx) const;
+    // get total frames of all clips
+    int getFrameNum() const;
+    // get names of the indexed bones
+    const std::vector<std::string>& getBoneNames() const;
+    // get world position of an indexed bone (by name), zero if the bone is not indexed
+    Eigen::Vector3d getPosition(const std::string& bone, int clip_idx, int frame_idx) const;
+    // Frames where the bone passes through the box, sorted by clip and frame. false if the bone is not indexed or
+    // the hierarchies are not built
+    bool queryBox(const std::string& bone, const Eigen::AlignedBox3d& box, std::vector<TrajectoryHit>* hits) const;
+    // Frames where the bone passes within radius of center, sorted by clip and frame. false like queryBox()
+    bool queryRadius(const std::string& bone, const Eigen::Vector3d& center, double radius,
+                     std::vector<TrajectoryHit>* hits) const;
+    // Frame where the bone passes closest to the point, clip is -1 if nothing is indexed or built
+    TrajectoryHit nearest(const std::string& bone, const Eigen::Vector3d& point) const;
+
+ private:
+    struct Segment final {
+        int clip;
+        // Global frames [begin, end), the path of the last one continues to frame end if it is in the same clip
+        int begin, end;
+    };
+    struct Node final {
+        Eigen::AlignedBox3d box;
+        // Range of this bone's tree-ordered segments below the node
+        int begin, end;
+        // -1 for leaves
+        int left, right;
+    };
+    // build() has run since the last addMotion()
+    bool isBuilt() const;
+    int findBone(const std::string& bone) const;
+    const double* position(int bone_slot, int frame) const;
+    // Path of a frame to the next frame of its clip
+    void getPath(int bone_slot, const Segment& segment, int frame, Eigen::Vector3d* from, Eigen::Vector3d* to) const;
+    Eigen::AlignedBox3d segmentBox(int bone_slot, const Segment& segment) const;
+    int buildNode(int bone_slot, const std::vector<Eigen::AlignedBox3d>& boxes, int begin, int end,
+                  std::vector<Node>* bone_nodes);
+    // Visit the segments of leaves whose boxes pass the test
+    template <class NodeTest, class SegmentVisitor>
+    void visit(int bone_slot, const NodeTest& test, const SegmentVisitor& visitor) const;
+
+    TrajectoryIndexOptions options;
+    std::vector<std::string> clip_names;
+    // Clip i owns frames [clip_offsets[i], clip_offsets[i + 1]) of positions
+    std::vector<int> clip_offsets = {0};
+    // Positions of every frame, frame major (3 doubles per indexed bone)
+    std::vector<double> positions;
+    std::vector<Segment> segments;
+    // Per bone: segment order of the tree leaves and the tree nodes (root first)
+    std::vector<std::vector<int>> tree_segments;
+    std::vector<std::vector<Node>> nodes;
+};
+}  // namespace kinematics
@@ -1,4 +1,6 @@
 #pragma once
 #include "util/filesystem.h"
 #include "util/helper.h"
+#include "util/simd.h"
+#include "util/thread_pool.h"
 #include "util/types.h"
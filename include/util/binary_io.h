@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace util {
+// Binary files of this program: a 4 byte magic and a version, then trivially copyable values in native byte order.
+// Vectors and strings are prefixed with their size as a 64-bit integer.
+template <typename T>
+void writeValue(std::ostream& output, const T& value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void writeArray(std::ostream& output, const T* values, std::size_t count) {
+    output.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+template <typename T>
+void writeVector(std::ostream& output, const std::vector<T>& values) {
+    writeValue(output, static_cast<std::uint64_t>(values.size()));
+    writeArray(output, values.data(), values.size());
+}
+
+void writeString(std::ostream& output, const std::string& value);
+void writeHeader(std::ostream& output, const char magic[4], std::uint32_t version);
+
+template <typename T>
+bool readValue(std::istream& input, T* value) {
+    input.read(reinterpret_cast<char*>(value), sizeof(T));
+    return static_cast<bool>(input);
+}
+
+template <typename T>
+bool readArray(std::istream& input, T* values, std::size_t count) {
+    input.read(reinterpret_cast<char*>(values), count * sizeof(T));
+    return static_cast<bool>(input);
+}
+
+// Sizes are checked against the file size so that a broken file cannot ask for huge allocations
+template <typename T>
+bool readVector(std::istream& input, std::uint64_t file_size, std::vector<T>* values) {
+    std::uint64_t size;
+    if (!readValue(input, &size) || size > file_size / sizeof(T)) return false;
+    values->resize(size);
+    return readArray(input, values->data(), size);
+}
+
+bool readString(std::istream& input, std::uint64_t file_size, std::string* value);
+// false if the file does not start with this magic and version
+bool readHeader(std::istream& input, const char magic[4], std::uint32_t version);
+}  // namespace util
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+
 #include "Eigen/Core"
 #include "Eigen/Geometry"
 
@@ -29,6 +31,13 @@ Eigen::Quaterniond rotateDegreeZYX(const Eigen::Vector4d& rotation);
 Eigen::Quaterniond rotateDegreeXYZ(double x, double y, double z);
 // Rotate along Z axis first then Y axis then X axis
 Eigen::Quaterniond rotateDegreeXYZ(const Eigen::Vector4d& rotation);
+// Batch version of rotateDegreeZYX, converts n Euler angles (degree) to quaternions.
+// Uses the SIMD kernels with polynomial sin / cos, coefficients are within 2e-15 of the Eigen version
+void rotateDegreeZYX(const Eigen::Vector4d* rotations, Eigen::Quaterniond* quaternions, std::size_t n);
+// Batch version of rotateDegreeXYZ, same accuracy as above
+void rotateDegreeXYZ(const Eigen::Vector4d* rotations, Eigen::Quaterniond* quaternions, std::size_t n);
+// Inverse of rotateDegreeZYX, Euler angles (x y z, degree) of the rotation
+Eigen::Vector4d toDegreeZYX(const Eigen::Quaterniond& rotation);
 // Rotate along X axis first then Y axis then Z axis
 Eigen::Quaterniond rotateRadianZYX(double x, double y, double z);
 // Rotate along X axis first then Y axis then Z axis
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+
+namespace util {
+namespace simd {
+// Instruction sets which have their own build of the math kernels
+enum class InstructionSet { Generic = 0, SSE42, AVX2, AVX512 };
+// Batched math kernels, compiled once per instruction set and picked at startup.
+// Vectors and quaternions use the memory layout of Eigen::Vector4d / Eigen::Quaterniond (4 doubles, x y z w),
+// matrices are column major like Eigen.
+struct Kernels final {
+    InstructionSet instruction_set;
+    const char* name;
+    // Euler angles (x y z, multiplied by angle_scale to get radian) to quaternions of Rz * Ry * Rx
+    void (*eulerToQuaternionZYX)(const double* euler, double angle_scale, double* quaternions, std::size_t n);
+    // Euler angles (x y z, multiplied by angle_scale to get radian) to quaternions of Rx * Ry * Rz
+    void (*eulerToQuaternionXYZ)(const double* euler, double angle_scale, double* quaternions, std::size_t n);
+    // Spherical linear interpolation from[i] -> to[i] with the same t, shortest path
+    void (*slerp)(const double* from, const double* to, double t, double* out, std::size_t n);
+    // Normalized linear interpolation, shortest path. Cheaper than slerp and close to it for nearby rotations
+    void (*nlerp)(const double* from, const double* to, double t, double* out, std::size_t n);
+    // nlerp from[i] -> to[i] with its own weights[i]
+    void (*blendQuaternions)(const double* from, const double* to, const double* weights, double* out, std::size_t n);
+    // out[i] = a[i] * b[i]
+    void (*multiplyQuaternions)(const double* a, const double* b, double* out, std::size_t n);
+    // out[i] = rotation * quaternions[i]
+    void (*rotateQuaternions)(const double* rotation, const double* quaternions, double* out, std::size_t n);
+    // out[i].xyz = transform (4 * 4) * (points[i].xyz, 1), out[i].w = points[i].w
+    void (*transformPoints)(const double* transform, const double* points, double* out, std::size_t n);
+    // Forward kinematics over bones sorted parent before child (parents[i] < 0 for the root).
+    // rest_rotations: 3 * 3 per bone, rotations relative to the parent applied before local_rotations (quaternions).
+    // offsets: bone vector (direction * length) in bone space, translations: in world space.
+    // Output rotations are 3 * 3 per bone, start / end positions use 4 doubles per bone.
+    void (*forwardKinematics)(const int* parents, const double* rest_rotations, const double* local_rotations,
+                              const double* offsets, const double* translations, double* rotations,
+                              double* start_positions, double* end_positions, std::size_t n);
+    // FIR filter centered on every sample (tap_num is odd), samples past both ends repeat the end values
+    void (*convolve)(const double* input, std::size_t n, const double* taps, std::size_t tap_num, double* out);
+    // out[i] = squared euclidean distance between query and vectors[i], every vector has `dimension` doubles
+    void (*squaredDistances)(const double* query, const double* vectors, std::size_t dimension, double* out,
+                             std::size_t n);
+    // Same for vectors stored dimension after dimension, element k of vector i is vectors[k * stride + i].
+    // Vectorizes across vectors, much faster for short vectors scanned many times
+    void (*squaredDistancesColumns)(const double* query, const double* vectors, std::size_t dimension,
+                                    std::size_t stride, double* out, std::size_t n);
+};
+// Query the widest instruction set supported by both this binary and the CPU (through CPUID)
+InstructionSet detectInstructionSet();
+// get the kernels picked at startup, set FK_SIMD=generic|sse4.2|avx2|avx512 to cap the choice
+const Kernels& kernels();
+// get the kernels built for specific instruction set, fall back to narrower ones if not built
+const Kernels& kernels(InstructionSet instruction_set);
+}  // namespace simd
+}  // namespace util
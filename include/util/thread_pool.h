@@ -0,0 +1,38 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+// Fixed size pool of worker threads for data parallel loops
+class ThreadPool final {
+ public:
+    // thread_count = 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(std::size_t thread_count = 0) noexcept;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+    // The pool shared by the whole program, created on first use
+    static ThreadPool& global();
+    // get number of threads running a parallelFor(), including the calling thread
+    std::size_t getThreadNum() const;
+    // Call body(begin, end) on disjoint ranges covering [0, count), ranges hold at least grain_size items
+    // (except the last one). Blocks until every range is done, the calling thread also takes ranges so it
+    // is safe to call from inside a worker.
+    void parallelFor(std::size_t count, std::size_t grain_size,
+                     const std::function<void(std::size_t, std::size_t)>& body);
+
+ private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    bool stopping = false;
+};
+}  // namespace util
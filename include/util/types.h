@@ -14,3 +14,4 @@ EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(Eigen::Affine3f)
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(Eigen::Affine3d)
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(Eigen::Matrix4f)
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(Eigen::Matrix4d)
+EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(Eigen::Quaterniond)
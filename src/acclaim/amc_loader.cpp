@@ -0,0 +1,119 @@
+#include "acclaim/amc_loader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "acclaim/skeleton.h"
+
+namespace acclaim {
+AMCReader::AMCReader() noexcept {}
+
+bool AMCReader::open(const util::fs::path &file_name, Skeleton *skeleton) {
+    input.open(file_name);
+    if (!input) return false;
+    bone_num = skeleton->getBoneNum();
+    // There are (NUM_BONES_IN_ASF_FILE - 2) moving bones and 2 dummy bones (lhipjoint and rhipjoint)
+    movable_bones = skeleton->getMovableBoneNum();
+    scale = skeleton->getScale();
+    bones.clear();
+    for (int i = 0; i < bone_num; ++i) {
+        const Bone &bone = *skeleton->getBonePointer(i);
+        BoneChannels &channels = bones[bone.name];
+        channels.idx = bone.idx;
+        channels.translation[0] = bone.doftx;
+        channels.translation[1] = bone.dofty;
+        channels.translation[2] = bone.doftz;
+        channels.rotation[0] = bone.dofrx;
+        channels.rotation[1] = bone.dofry;
+        channels.rotation[2] = bone.dofrz;
+    }
+    // Ignore header
+    input.ignore(1024, '\n');
+    input.ignore(1024, '\n');
+    input.ignore(1024, '\n');
+    return true;
+}
+
+bool AMCReader::next(Posture *posture) {
+    int frame_num;
+    if (!(input >> frame_num)) return false;
+    if (posture->bone_rotations.size() != static_cast<std::size_t>(bone_num)) *posture = Posture(bone_num);
+    // Bones not listed in the frame stay at rest
+    for (int i = 0; i < bone_num; ++i) {
+        posture->bone_rotations[i].setZero();
+        posture->bone_translations[i].setZero();
+    }
+    posture->bone_quaternions.clear();
+    std::string bone_name;
+    for (int i = 0; i < movable_bones; ++i) {
+        input >> bone_name;
+        auto bone = bones.find(bone_name);
+        if (!input || bone == bones.end()) {
+            if (input) std::cerr << "Unknown bone " << bone_name << " in frame " << frame_num << std::endl;
+            return false;
+        }
+        const BoneChannels &channels = bone->second;
+        Eigen::Vector4d &translation = posture->bone_translations[channels.idx];
+        Eigen::Vector4d &rotation = posture->bone_rotations[channels.idx];
+        for (int k = 0; k < 3; ++k) {
+            if (channels.translation[k]) input >> translation[k];
+        }
+        for (int k = 0; k < 3; ++k) {
+            if (channels.rotation[k]) input >> rotation[k];
+        }
+        if (channels.idx == 0) translation *= scale;
+    }
+    return static_cast<bool>(input);
+}
+
+AMCLoader::AMCLoader(const util::fs::path &file_name, Skeleton *skeleton, int batch_size) noexcept {
+    if (!reader.open(file_name, skeleton)) {
+        std::cerr << "Failed to open " << file_name << std::endl;
+        finished = failed = true;
+        return;
+    }
+    worker = std::thread(&AMCLoader::parse, this, std::max(1, batch_size));
+}
+
+AMCLoader::~AMCLoader() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+}
+
+int AMCLoader::poll(std::vector<Posture> *postures) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = static_cast<int>(parsed.size());
+    postures->insert(postures->end(), std::make_move_iterator(parsed.begin()), std::make_move_iterator(parsed.end()));
+    parsed.clear();
+    return count;
+}
+
+bool AMCLoader::isDone() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finished && parsed.empty();
+}
+
+bool AMCLoader::hasFailed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void AMCLoader::parse(int batch_size) {
+    std::vector<Posture> batch;
+    batch.reserve(batch_size);
+    Posture posture;
+    bool more = true;
+    while (more && !stopping) {
+        more = reader.next(&posture);
+        if (more) batch.emplace_back(std::move(posture));
+        // Frames are handed over a batch at a time so the lock is not taken for every frame
+        if (static_cast<int>(batch.size()) == batch_size || !more) {
+            std::lock_guard<std::mutex> lock(mutex);
+            parsed.insert(parsed.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            finished = !more;
+            batch.clear();
+        }
+    }
+}
+}  // namespace acclaim
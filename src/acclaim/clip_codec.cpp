@@ -0,0 +1,373 @@
+#include "acclaim/clip_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "util/binary_io.h"
+
+namespace acclaim {
+namespace {
+constexpr char file_magic[4] = {'F', 'K', 'M', 'C'};
+constexpr std::uint32_t file_version = 1;
+constexpr int max_decimals = 22;
+// Powers of ten up to 10^22 are exact doubles, so mantissa / 10^decimals rounds like parsing the decimal text
+constexpr double powers_of_ten[max_decimals + 1] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                                    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+// Mantissas stay exact doubles
+constexpr double max_mantissa = 9007199254740992.0;
+constexpr std::size_t read_buffer_size = 1 << 16;
+// Channel modes, same values as ClipDecoder::ChannelMode
+constexpr std::uint8_t mode_constant = 0, mode_decimal = 1, mode_raw = 2;
+// Magic, version, bone and frame counts, frame rate and the quaternion flag
+constexpr std::uint64_t header_size = 4 + 4 + 4 + 4 + 8 + 1;
+// Mode, order, decimals, factor and constant of every channel
+constexpr std::uint64_t channel_header_size = 1 + 1 + 1 + 8 + 8;
+
+bool sameBits(double a, double b) { return std::memcmp(&a, &b, sizeof(double)) == 0; }
+
+double decimalValue(std::int64_t mantissa, int decimals, double factor) {
+    return static_cast<double>(mantissa) / powers_of_ten[decimals] * factor;
+}
+
+// Mantissa giving back exactly value, false if value is not such a decimal
+bool decimalMantissa(double value, int decimals, double factor, std::int64_t *mantissa) {
+    double scaled = value / factor * powers_of_ten[decimals];
+    if (!(std::abs(scaled) < max_mantissa - 1.0)) return false;
+    std::int64_t rounded = std::llround(scaled);
+    // Dividing by the factor may round to a neighbour of the mantissa the value came from
+    for (std::int64_t candidate : {rounded, rounded - 1, rounded + 1}) {
+        if (sameBits(decimalValue(candidate, decimals, factor), value)) {
+            *mantissa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Nearest mantissa of a value that is not such a decimal, kept as history after escaping it so that predictions
+// stay within a few mantissa ranges
+std::int64_t nearestMantissa(double value, int decimals, double factor) {
+    double scaled = value / factor * powers_of_ten[decimals];
+    if (!(std::abs(scaled) < max_mantissa)) return scaled > 0.0 ? 1ll << 53 : scaled < 0.0 ? -(1ll << 53) : 0;
+    return std::llround(scaled);
+}
+
+// Mantissa predicted from the previous ones, frame is the number of frames already coded
+std::int64_t predict(const std::int64_t previous[2], std::uint8_t order, int frame) {
+    if (frame == 0) return 0;
+    if (order == 1 || frame == 1) return previous[0];
+    return 2 * previous[0] - previous[1];
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+int varintSize(std::uint64_t value) {
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void writeVarint(std::uint64_t value, std::ostream &output) {
+    while (value >= 0x80) {
+        output.put(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    output.put(static_cast<char>(value));
+}
+
+// Channel c of bone j: rotation (4 doubles), translation (4) then quaternion (4) if present
+double *channelData(Posture *posture, int bone_idx, int channel) {
+    if (channel < 4) return posture->bone_rotations[bone_idx].data() + channel;
+    if (channel < 8) return posture->bone_translations[bone_idx].data() + channel - 4;
+    return posture->bone_quaternions[bone_idx].coeffs().data() + channel - 8;
+}
+
+double channelValue(const Posture &posture, int bone_idx, int channel) {
+    if (channel < 4) return posture.bone_rotations[bone_idx][channel];
+    if (channel < 8) return posture.bone_translations[bone_idx][channel - 4];
+    return posture.bone_quaternions[bone_idx].coeffs()[channel - 8];
+}
+
+struct ChannelCode final {
+    std::uint8_t mode = mode_constant;
+    std::uint8_t order = 1;
+    std::uint8_t decimals = 0;
+    double factor = 1.0;
+    double constant = 0.0;
+    // Mantissas of decimal channels, escaped values are marked in fits
+    std::vector<std::int64_t> mantissas;
+    std::vector<bool> fits;
+};
+
+// Pick the cheapest coding of one channel, allow_constant = false codes constant values frame by frame
+ChannelCode chooseCode(const std::vector<double> &values, double scale, bool allow_constant = true) {
+    ChannelCode code;
+    code.constant = values[0];
+    bool constant = allow_constant;
+    for (double value : values) constant = constant && sameBits(value, values[0]);
+    if (constant) return code;
+    // Decimals and factor fitting most values, every value fits from its own shortest decimal on
+    std::size_t best_failures = values.size() + 1;
+    std::vector<int> shortest(values.size());
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (attempt == 1 && (scale == 1.0 || scale == 0.0)) break;
+        double factor = attempt == 0 ? 1.0 : scale;
+        std::int64_t mantissa;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            shortest[i] = -1;
+            for (int decimals = 0; decimals <= max_decimals && shortest[i] < 0; ++decimals) {
+                if (decimalMantissa(values[i], decimals, factor, &mantissa)) shortest[i] = decimals;
+            }
+        }
+        for (int decimals = 0; decimals <= max_decimals; ++decimals) {
+            std::size_t failures = 0;
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                bool fits = shortest[i] >= 0 && shortest[i] <= decimals &&
+                            std::abs(values[i] / factor) * powers_of_ten[decimals] < max_mantissa - 1.0;
+                failures += fits ? 0 : 1;
+            }
+            if (failures < best_failures) {
+                best_failures = failures;
+                code.decimals = static_cast<std::uint8_t>(decimals);
+                code.factor = factor;
+            }
+        }
+    }
+    code.mantissas.resize(values.size());
+    code.fits.resize(values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        std::int64_t mantissa = 0;
+        code.fits[i] = decimalMantissa(values[i], code.decimals, code.factor, &mantissa);
+        code.mantissas[i] = mantissa;
+    }
+    // Bytes of both predictors against storing raw doubles
+    std::size_t best_size = values.size() * sizeof(double);
+    code.mode = mode_raw;
+    for (std::uint8_t order : {1, 2}) {
+        std::int64_t previous[2] = {0, 0};
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            std::int64_t predicted = predict(previous, order, static_cast<int>(i));
+            std::int64_t mantissa =
+                code.fits[i] ? code.mantissas[i] : nearestMantissa(values[i], code.decimals, code.factor);
+            size += code.fits[i] ? varintSize(zigzag(mantissa - predicted) << 1) : 1 + sizeof(double);
+            previous[1] = previous[0];
+            previous[0] = mantissa;
+        }
+        if (size < best_size) {
+            best_size = size;
+            code.mode = mode_decimal;
+            code.order = order;
+        }
+    }
+    return code;
+}
+}  // namespace
+
+bool writeClipFile(const util::fs::path &file_name, const std::vector<Posture> &postures, double frame_rate,
+                   double scale) {
+    const int total_frames = static_cast<int>(postures.size());
+    const int total_bones = total_frames > 0 ? static_cast<int>(postures[0].bone_rotations.size()) : 0;
+    const bool quaternions = total_frames > 0 && !postures[0].bone_quaternions.empty();
+    const int bone_channels = quaternions ? 12 : 8;
+    std::ofstream output(file_name, std::ios::binary);
+    if (!output) {
+        std::cerr << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    util::writeHeader(output, file_magic, file_version);
+    util::writeValue(output, static_cast<std::uint32_t>(total_bones));
+    util::writeValue(output, static_cast<std::uint32_t>(total_frames));
+    util::writeValue(output, frame_rate);
+    util::writeValue(output, static_cast<std::uint8_t>(quaternions));
+    // Channels are coded one by one over the whole clip, then interleaved frame by frame for streaming
+    std::vector<ChannelCode> codes(static_cast<std::size_t>(total_bones) * bone_channels);
+    std::vector<double> values(total_frames);
+    bool frame_data = false;
+    for (int j = 0; j < total_bones; ++j) {
+        for (int c = 0; c < bone_channels; ++c) {
+            for (int i = 0; i < total_frames; ++i) values[i] = channelValue(postures[i], j, c);
+            ChannelCode &code = codes[j * bone_channels + c];
+            code = chooseCode(values, scale);
+            frame_data = frame_data || code.mode != mode_constant;
+        }
+    }
+    // Every frame takes at least a byte, which lets the decoder check the frame count against the file size
+    if (!frame_data && !codes.empty()) {
+        for (int i = 0; i < total_frames; ++i) values[i] = channelValue(postures[i], 0, 0);
+        codes[0] = chooseCode(values, scale, false);
+    }
+    for (const ChannelCode &code : codes) {
+        util::writeValue(output, code.mode);
+        util::writeValue(output, code.order);
+        util::writeValue(output, code.decimals);
+        util::writeValue(output, code.factor);
+        util::writeValue(output, code.constant);
+    }
+    std::vector<std::array<std::int64_t, 2>> previous(codes.size(), {0, 0});
+    for (int i = 0; i < total_frames; ++i) {
+        for (std::size_t c = 0; c < codes.size(); ++c) {
+            const ChannelCode &code = codes[c];
+            if (code.mode == mode_raw) {
+                util::writeValue(output, channelValue(postures[i], c / bone_channels, c % bone_channels));
+            } else if (code.mode == mode_decimal) {
+                std::int64_t predicted = predict(previous[c].data(), code.order, i);
+                std::int64_t mantissa = code.mantissas[i];
+                if (code.fits[i]) {
+                    writeVarint(zigzag(mantissa - predicted) << 1, output);
+                } else {
+                    double value = channelValue(postures[i], c / bone_channels, c % bone_channels);
+                    mantissa = nearestMantissa(value, code.decimals, code.factor);
+                    writeVarint(1, output);
+                    util::writeValue(output, value);
+                }
+                previous[c][1] = previous[c][0];
+                previous[c][0] = mantissa;
+            }
+        }
+    }
+    return static_cast<bool>(output);
+}
+
+ClipDecoder::ClipDecoder() noexcept {}
+
+bool ClipDecoder::open(const util::fs::path &file_name) {
+    input.close();
+    input.clear();
+    input.open(file_name, std::ios::binary);
+    buffer.resize(read_buffer_size);
+    buffer_position = buffer_end = 0;
+    decoded_frames = frame_num = bone_num = 0;
+    if (!input) return false;
+    std::uint64_t file_size = util::fs::file_size(file_name);
+    // Headers are read straight from the file, the buffer only serves frames
+    std::uint32_t total_bones, total_frames;
+    std::uint8_t has_quaternions;
+    if (!util::readHeader(input, file_magic, file_version) || !util::readValue(input, &total_bones) ||
+        !util::readValue(input, &total_frames) || !util::readValue(input, &frame_rate) ||
+        !util::readValue(input, &has_quaternions)) {
+        std::cerr << file_name << " is not a clip file" << std::endl;
+        return false;
+    }
+    // Counts are checked against the file size so that a broken file cannot ask for huge allocations
+    quaternions = has_quaternions != 0;
+    const std::uint64_t channel_num = std::uint64_t(total_bones) * (quaternions ? 12 : 8);
+    if (channel_num * channel_header_size > file_size - header_size) {
+        std::cerr << file_name << " is broken" << std::endl;
+        return false;
+    }
+    bone_num = static_cast<int>(total_bones);
+    channels.assign(channel_num, Channel());
+    // Every frame takes at least a byte of each decimal channel and 8 bytes of each raw one
+    std::uint64_t frame_size = 0;
+    for (Channel &channel : channels) {
+        std::uint8_t mode;
+        if (!util::readValue(input, &mode) || !util::readValue(input, &channel.order) ||
+            !util::readValue(input, &channel.decimals) || !util::readValue(input, &channel.factor) ||
+            !util::readValue(input, &channel.constant) || mode > mode_raw || channel.decimals > max_decimals) {
+            std::cerr << file_name << " is broken" << std::endl;
+            return false;
+        }
+        channel.mode = static_cast<ChannelMode>(mode);
+        frame_size += mode == mode_raw ? sizeof(double) : mode == mode_decimal ? 1 : 0;
+    }
+    // writeClipFile() codes at least one channel per frame
+    const std::uint64_t data_size = file_size - header_size - channel_num * channel_header_size;
+    if (total_frames > std::uint64_t(std::numeric_limits<int>::max()) ||
+        total_frames > data_size / std::max<std::uint64_t>(frame_size, 1)) {
+        std::cerr << file_name << " is broken" << std::endl;
+        return false;
+    }
+    frame_num = static_cast<int>(total_frames);
+    return true;
+}
+
+int ClipDecoder::getFrameNum() const { return frame_num; }
+
+int ClipDecoder::getBoneNum() const { return bone_num; }
+
+double ClipDecoder::getFrameRate() const { return frame_rate; }
+
+bool ClipDecoder::next(Posture *posture) {
+    if (decoded_frames >= frame_num) return false;
+    if (posture->bone_rotations.size() != static_cast<std::size_t>(bone_num)) *posture = Posture(bone_num);
+    if (quaternions) {
+        posture->bone_quaternions.resize(bone_num);
+    } else {
+        posture->bone_quaternions.clear();
+    }
+    const int bone_channels = quaternions ? 12 : 8;
+    for (int j = 0; j < bone_num; ++j) {
+        Channel *channel = &channels[static_cast<std::size_t>(j) * bone_channels];
+        for (int c = 0; c < bone_channels; ++c, ++channel) {
+            double *value = channelData(posture, j, c);
+            if (channel->mode == ChannelMode::Constant) {
+                *value = channel->constant;
+                continue;
+            }
+            if (channel->mode == ChannelMode::Raw) {
+                if (!readBytes(value, sizeof(double))) return false;
+                continue;
+            }
+            std::uint64_t code;
+            if (!readVarint(&code)) return false;
+            std::int64_t mantissa;
+            if (code & 1) {
+                if (!readBytes(value, sizeof(double))) return false;
+                mantissa = nearestMantissa(*value, channel->decimals, channel->factor);
+            } else {
+                mantissa = predict(channel->previous, channel->order, decoded_frames) + unzigzag(code >> 1);
+                *value = decimalValue(mantissa, channel->decimals, channel->factor);
+            }
+            channel->previous[1] = channel->previous[0];
+            channel->previous[0] = mantissa;
+        }
+    }
+    ++decoded_frames;
+    return true;
+}
+
+bool ClipDecoder::readByte(std::uint8_t *byte) {
+    if (buffer_position == buffer_end) {
+        input.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+        buffer_position = 0;
+        buffer_end = static_cast<std::size_t>(input.gcount());
+        if (buffer_end == 0) return false;
+    }
+    *byte = buffer[buffer_position++];
+    return true;
+}
+
+bool ClipDecoder::readVarint(std::uint64_t *value) {
+    *value = 0;
+    std::uint8_t byte;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (!readByte(&byte)) return false;
+        *value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+bool ClipDecoder::readBytes(void *data, std::size_t size) {
+    std::uint8_t *bytes = static_cast<std::uint8_t *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        if (!readByte(bytes + i)) return false;
+    }
+    return true;
+}
+}  // namespace acclaim
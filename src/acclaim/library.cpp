@@ -0,0 +1,252 @@
+#include "acclaim/library.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "util/thread_pool.h"
+
+namespace acclaim {
+namespace {
+constexpr const char *index_header = "# motion library index v1";
+// AMC files do not store the capture rate, CMU data is recorded at 120 Hz
+constexpr double default_frame_rate = 120.0;
+
+bool hasExtension(const util::fs::path &file, const char *extension) {
+    std::string value = file.extension().string();
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value == extension;
+}
+
+std::string relativeName(const util::fs::path &file, const util::fs::path &root) {
+    std::string name = file.generic_string();
+    std::string prefix = root.generic_string();
+    if (name.compare(0, prefix.size(), prefix) == 0) name.erase(0, prefix.size());
+    while (!name.empty() && name.front() == '/') name.erase(0, 1);
+    return name;
+}
+
+std::int64_t modifiedTime(const util::fs::path &file) {
+    std::error_code error;
+    auto time = util::fs::last_write_time(file, error);
+    return error ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+}
+
+// FNV-1a over the file content, 0 if it cannot be read
+std::uint64_t hashFile(const util::fs::path &file) {
+    std::ifstream input(file, std::ios::binary);
+    if (!input) return 0;
+    std::uint64_t hash = 14695981039346656037ull;
+    char buffer[4096];
+    while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0) {
+        for (std::streamsize i = 0; i < input.gcount(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// Every frame starts with a line holding only the frame number
+int countFrames(const util::fs::path &amc_file) {
+    std::ifstream input(amc_file);
+    if (!input) return 0;
+    int frame_num = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        std::size_t end = line.find_last_not_of(" \t\r");
+        if (end == std::string::npos) continue;
+        std::size_t begin = line.find_first_not_of(" \t");
+        bool digits = true;
+        for (std::size_t i = begin; i <= end && digits; ++i) digits = std::isdigit(static_cast<unsigned char>(line[i]));
+        if (digits) ++frame_num;
+    }
+    return frame_num;
+}
+
+// ASF file in the same directory, preferring the one whose name starts the clip's name (CMU uses 01.asf for 01_01.amc)
+util::fs::path pickSkeleton(const util::fs::path &amc_file, const std::vector<util::fs::path> &candidates) {
+    std::string clip = amc_file.stem().string();
+    const util::fs::path *best = candidates.empty() ? nullptr : &candidates.front();
+    std::size_t best_length = 0;
+    for (const util::fs::path &candidate : candidates) {
+        std::string stem = candidate.stem().string();
+        if (stem.size() > best_length && clip.compare(0, stem.size(), stem) == 0) {
+            best = &candidate;
+            best_length = stem.size();
+        }
+    }
+    return best == nullptr ? util::fs::path() : *best;
+}
+
+// Entries keyed by AMC path relative to the root
+std::map<std::string, ClipInfo> readIndex(const util::fs::path &index_file) {
+    std::map<std::string, ClipInfo> entries;
+    std::ifstream input(index_file);
+    std::string line;
+    if (!input || !std::getline(input, line) || line != index_header) return entries;
+    while (std::getline(input, line)) {
+        std::istringstream fields(line);
+        ClipInfo info;
+        std::string skeleton_file, amc_file;
+        fields >> info.file_size >> info.modified_time >> info.frame_num >> std::hex >> info.skeleton_hash;
+        fields.ignore(1, '\t');
+        // Paths may contain spaces, both are tab separated and the AMC path runs to the end of the line
+        if (!fields || !std::getline(fields, skeleton_file, '\t') || !std::getline(fields, amc_file)) continue;
+        info.skeleton_file = skeleton_file;
+        entries[amc_file] = std::move(info);
+    }
+    return entries;
+}
+
+bool writeIndex(const util::fs::path &index_file, const util::fs::path &root, const std::vector<ClipInfo> &clips) {
+    std::ofstream output(index_file);
+    if (!output) {
+        std::cerr << "Failed to open " << index_file << std::endl;
+        return false;
+    }
+    output << index_header << '\n';
+    for (const ClipInfo &info : clips) {
+        output << info.file_size << '\t' << info.modified_time << '\t' << info.frame_num << '\t' << std::hex
+               << info.skeleton_hash << std::dec << '\t' << relativeName(info.skeleton_file, root) << '\t'
+               << relativeName(info.amc_file, root) << '\n';
+    }
+    return static_cast<bool>(output);
+}
+}  // namespace
+
+MotionLibrary::MotionLibrary(std::size_t _byte_budget, double _skeleton_scale) noexcept
+    : byte_budget(_byte_budget), skeleton_scale(_skeleton_scale) {}
+
+int MotionLibrary::scan(const util::fs::path &root, const util::fs::path &index_file) {
+    clips.clear();
+    cache.clear();
+    recently_used.clear();
+    cached_bytes = 0;
+    skeletons.clear();
+    std::error_code error;
+    if (!util::fs::is_directory(root, error)) {
+        std::cerr << root << " is not a directory" << std::endl;
+        return 0;
+    }
+    std::vector<util::fs::path> amc_files;
+    std::map<util::fs::path, std::vector<util::fs::path>> asf_files;
+    for (util::fs::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error)) {
+        if (!util::fs::is_regular_file(it->status())) continue;
+        const util::fs::path &file = it->path();
+        if (hasExtension(file, ".amc")) amc_files.emplace_back(file);
+        if (hasExtension(file, ".asf")) asf_files[file.parent_path()].emplace_back(file);
+    }
+    std::sort(amc_files.begin(), amc_files.end());
+    for (auto &directory : asf_files) std::sort(directory.second.begin(), directory.second.end());
+    // ASF files are small, always hash them so an edited skeleton is noticed even if the clip is not
+    std::map<util::fs::path, std::uint64_t> skeleton_hashes;
+    std::map<std::string, ClipInfo> indexed = readIndex(index_file);
+    std::vector<int> stale;
+    for (const util::fs::path &amc_file : amc_files) {
+        auto directory = asf_files.find(amc_file.parent_path());
+        if (directory == asf_files.end()) {
+            std::cerr << "No skeleton for " << amc_file << ", skipped" << std::endl;
+            continue;
+        }
+        ClipInfo info;
+        info.amc_file = amc_file;
+        info.skeleton_file = pickSkeleton(amc_file, directory->second);
+        auto hash = skeleton_hashes.find(info.skeleton_file);
+        if (hash == skeleton_hashes.end()) {
+            hash = skeleton_hashes.emplace(info.skeleton_file, hashFile(info.skeleton_file)).first;
+        }
+        info.skeleton_hash = hash->second;
+        std::string relative = relativeName(amc_file, root);
+        info.name = relative.substr(0, relative.size() - amc_file.extension().string().size());
+        info.file_size = static_cast<std::uint64_t>(util::fs::file_size(amc_file, error));
+        info.modified_time = modifiedTime(amc_file);
+        auto entry = indexed.find(relative);
+        if (entry != indexed.end() && entry->second.file_size == info.file_size &&
+            entry->second.modified_time == info.modified_time &&
+            entry->second.skeleton_file == relativeName(info.skeleton_file, root)) {
+            info.frame_num = entry->second.frame_num;
+        } else {
+            stale.emplace_back(static_cast<int>(clips.size()));
+        }
+        clips.emplace_back(std::move(info));
+    }
+    // Reading whole AMC files dominates the scan, spread new and changed ones over the pool
+    util::ThreadPool::global().parallelFor(stale.size(), 1, [this, &stale](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) clips[stale[i]].frame_num = countFrames(clips[stale[i]].amc_file);
+    });
+    auto empty = std::remove_if(clips.begin(), clips.end(), [](const ClipInfo &info) {
+        if (info.frame_num == 0) std::cerr << "No frames in " << info.amc_file << ", skipped" << std::endl;
+        return info.frame_num == 0;
+    });
+    bool changed = !stale.empty() || empty != clips.end() || indexed.size() != clips.size();
+    clips.erase(empty, clips.end());
+    for (ClipInfo &info : clips) info.duration = info.frame_num / default_frame_rate;
+    if (changed) writeIndex(index_file, root, clips);
+    cache.resize(clips.size());
+    return getClipNum();
+}
+
+int MotionLibrary::getClipNum() const { return static_cast<int>(clips.size()); }
+
+const ClipInfo &MotionLibrary::getClipInfo(int clip_idx) const { return clips[clip_idx]; }
+
+int MotionLibrary::findClip(const std::string &name) const {
+    auto it = std::find_if(clips.begin(), clips.end(), [&name](const ClipInfo &info) { return info.name == name; });
+    return it == clips.end() ? -1 : static_cast<int>(it - clips.begin());
+}
+
+std::shared_ptr<Motion> MotionLibrary::getMotion(int clip_idx) {
+    CachedClip &cached = cache[clip_idx];
+    if (cached.motion) {
+        ++statistics.hits;
+        recently_used.splice(recently_used.begin(), recently_used, cached.position);
+        return cached.motion;
+    }
+    const ClipInfo &info = clips[clip_idx];
+    std::unique_ptr<Skeleton> &skeleton = skeletons[info.skeleton_hash];
+    if (!skeleton) skeleton = std::make_unique<Skeleton>(info.skeleton_file, skeleton_scale);
+    // Not make_shared, Motion needs its aligned operator new
+    std::shared_ptr<Motion> motion(new Motion(info.amc_file, std::make_unique<Skeleton>(*skeleton)));
+    if (motion->getFrameNum() == 0) return nullptr;
+    if (quantized) motion->quantize();
+    ++statistics.loads;
+    if (cached.evicted) ++statistics.reloads;
+    cached.motion = motion;
+    cached.bytes = motion->getByteSize();
+    cached_bytes += cached.bytes;
+    recently_used.push_front(clip_idx);
+    cached.position = recently_used.begin();
+    evict();
+    return motion;
+}
+
+std::size_t MotionLibrary::getByteBudget() const { return byte_budget; }
+
+void MotionLibrary::setByteBudget(std::size_t _byte_budget) {
+    byte_budget = _byte_budget;
+    evict();
+}
+
+void MotionLibrary::setQuantized(bool _quantized) { quantized = _quantized; }
+
+std::size_t MotionLibrary::getCachedBytes() const { return cached_bytes; }
+
+const MotionLibraryStatistics &MotionLibrary::getStatistics() const { return statistics; }
+
+void MotionLibrary::evict() {
+    while (cached_bytes > byte_budget && recently_used.size() > 1) {
+        CachedClip &cached = cache[recently_used.back()];
+        recently_used.pop_back();
+        cached_bytes -= cached.bytes;
+        cached.motion.reset();
+        cached.bytes = 0;
+        cached.evicted = true;
+        ++statistics.evictions;
+    }
+}
+}  // namespace acclaim
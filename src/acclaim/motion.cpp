@@ -1,33 +1,61 @@
 #include "acclaim/motion.h"
-#include <fstream>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <utility>
 
+#include "acclaim/amc_loader.h"
+#include "acclaim/clip_codec.h"
 #include "simulation/kinematics.h"
 
 namespace acclaim {
 Motion::Motion(const util::fs::path &amc_file, std::unique_ptr<Skeleton> &&_skeleton) noexcept
     : skeleton(std::move(_skeleton)) {
     postures.reserve(1024);
-    if (!this->readAMCFile(amc_file)) {
+    bool loaded = amc_file.extension() == clip_file_extension ? readClipFile(amc_file) : readAMCFile(amc_file);
+    if (!loaded) {
         std::cerr << "Error in reading AMC file, this object is not initialized!" << std::endl;
         std::cerr << "You can call readAMCFile() to initialize again" << std::endl;
         postures.resize(0);
     }
 }
 
+Motion::Motion(std::vector<Posture> &&_postures, std::unique_ptr<Skeleton> &&_skeleton, double _frame_rate) noexcept
+    : skeleton(std::move(_skeleton)), postures(std::move(_postures)), frame_rate(_frame_rate) {}
+
 const std::unique_ptr<Skeleton> &Motion::getSkeleton() const { return skeleton; }
 
 Motion::Motion(const Motion &other) noexcept
-    : skeleton(std::make_unique<Skeleton>(*other.skeleton)), postures(other.postures) {}
+    : skeleton(std::make_unique<Skeleton>(*other.skeleton)),
+      postures(other.postures),
+      quantized(other.quantized),
+      frame_rate(other.frame_rate),
+      time_map(other.time_map),
+      update_interval(other.update_interval) {}
 
-Motion::Motion(Motion &&other) noexcept : skeleton(std::move(other.skeleton)), postures(std::move(other.postures)) {}
+Motion::Motion(Motion &&other) noexcept
+    : skeleton(std::move(other.skeleton)),
+      postures(std::move(other.postures)),
+      quantized(std::move(other.quantized)),
+      frame_rate(other.frame_rate),
+      sampled_posture(std::move(other.sampled_posture)),
+      time_map(std::move(other.time_map)),
+      warped_frames(other.warped_frames),
+      warped_postures(std::move(other.warped_postures)),
+      update_interval(other.update_interval),
+      key_frames(other.key_frames),
+      key_poses(std::move(other.key_poses)) {}
 
 Motion &Motion::operator=(const Motion &other) noexcept {
     if (this != &other) {
         skeleton.reset();
         skeleton = std::make_unique<Skeleton>(*other.skeleton);
         postures = other.postures;
+        quantized = other.quantized;
+        frame_rate = other.frame_rate;
+        time_map = other.time_map;
+        update_interval = other.update_interval;
+        clearCache();
     }
     return *this;
 }
@@ -36,70 +64,285 @@ Motion &Motion::operator=(Motion &&other) noexcept {
     if (this != &other) {
         skeleton = std::move(other.skeleton);
         postures = std::move(other.postures);
+        quantized = std::move(other.quantized);
+        frame_rate = other.frame_rate;
+        sampled_posture = std::move(other.sampled_posture);
+        time_map = std::move(other.time_map);
+        warped_frames = other.warped_frames;
+        warped_postures = std::move(other.warped_postures);
+        update_interval = other.update_interval;
+        key_frames = other.key_frames;
+        key_poses = std::move(other.key_poses);
     }
     return *this;
 }
 
-int Motion::getFrameNum() const { return static_cast<int>(postures.size()); }
+int Motion::getFrameNum() const {
+    return isQuantized() ? quantized.getFrameNum() : static_cast<int>(postures.size());
+}
+
+const Posture &Motion::getPosture(int frame_idx) const {
+    if (!time_map && !isQuantized()) return postures[frame_idx];
+    double source_frame = time_map ? std::clamp(time_map(frame_idx), 0.0, double(getFrameNum() - 1)) : frame_idx;
+    // Frames landing exactly on a source frame (e.g. the shifted part after a keyframe) need no interpolation
+    if (!isQuantized() && source_frame == std::floor(source_frame)) return postures[static_cast<int>(source_frame)];
+    // Quantized frames go through the same cache as warped ones
+    int slot = frame_idx % warp_cache_size;
+    if (warped_frames[slot] != frame_idx) {
+        if (isQuantized()) {
+            warpQuantized(source_frame, &warped_postures[slot]);
+        } else {
+            kinematics::warpPostureQuaternion(postures, source_frame, &warped_postures[slot]);
+        }
+        warped_frames[slot] = frame_idx;
+    }
+    return warped_postures[slot];
+}
+
+double Motion::getFrameRate() const { return frame_rate; }
+
+void Motion::setFrameRate(double _frame_rate) { frame_rate = _frame_rate; }
+
+double Motion::getDuration() const { return getFrameNum() / frame_rate; }
+
+std::size_t Motion::getByteSize() const {
+    std::size_t bytes = sizeof(Motion) + postures.capacity() * sizeof(Posture) + quantized.getByteSize();
+    for (const Posture &posture : postures) {
+        bytes += (posture.bone_rotations.capacity() + posture.bone_translations.capacity()) * sizeof(Eigen::Vector4d);
+        bytes += posture.bone_quaternions.capacity() * sizeof(Eigen::Quaterniond);
+    }
+    return bytes;
+}
+
+void Motion::sample(double seconds) {
+    // Clips loading in the background start without frames, the skeleton keeps its pose
+    if (getFrameNum() == 0) return;
+    double frame = std::clamp(seconds * frame_rate, 0.0, double(getFrameNum() - 1));
+    int lower = static_cast<int>(frame);
+    double t = frame - lower;
+    // Interpolated updates already blend between key frames
+    if (t == 0.0 || update_interval > 1 || lower + 1 >= getFrameNum()) {
+        setBoneTransform(lower);
+        return;
+    }
+    // Both frames stay in the warp cache since they use different slots
+    kinematics::interpolatePosture(getPosture(lower), getPosture(lower + 1), t, &sampled_posture);
+    solvePosture(sampled_posture);
+    skeleton->setModelMatrices();
+}
 
 void Motion::setBoneTransform(int frame_idx) {
-    kinematics::forwardSolver(postures[frame_idx], skeleton->getBonePointer(0));
+    int key_frame = frame_idx - frame_idx % update_interval;
+    int next_key_frame = key_frame + update_interval;
+    if (update_interval == 1 || next_key_frame >= getFrameNum()) {
+        solveFrame(frame_idx);
+    } else {
+        // Reuse solved key frames, advancing usually shifts the old upper key frame down
+        if (key_frames[1] == key_frame) {
+            std::swap(key_frames[0], key_frames[1]);
+            std::swap(key_poses[0], key_poses[1]);
+        }
+        for (int i = 0; i < 2; ++i) {
+            int wanted = i == 0 ? key_frame : next_key_frame;
+            if (key_frames[i] != wanted) {
+                solveFrame(wanted);
+                kinematics::capturePose(skeleton.get(), &key_poses[i]);
+                key_frames[i] = wanted;
+            }
+        }
+        double t = static_cast<double>(frame_idx - key_frame) / update_interval;
+        kinematics::blendPose(key_poses[0], key_poses[1], t, skeleton.get());
+    }
     skeleton->setModelMatrices();
 }
 
-void Motion::timeWarper(int oldframe, int newframe) { postures = kinematics::timeWarper(postures, oldframe, newframe); }
+int Motion::getUpdateInterval() const { return update_interval; }
+
+void Motion::setUpdateInterval(int interval) { update_interval = std::max(1, interval); }
+
+void Motion::setLOD(const kinematics::LODSelection &lod) {
+    if (skeleton->getLODLevel() != lod.level) {
+        skeleton->setLODLevel(lod.level);
+        // Cached key frames were solved with the other skeleton
+        key_frames = {-1, -1};
+    }
+    setUpdateInterval(lod.update_interval);
+}
+
+void Motion::solveFrame(int frame_idx) {
+    if (isQuantized() && !time_map && skeleton->getLODLevel() == 0) {
+        kinematics::forwardSolverQuantized(quantized, frame_idx, skeleton.get());
+    } else {
+        solvePosture(getPosture(frame_idx));
+    }
+}
+
+void Motion::solvePosture(const Posture &posture) {
+    if (skeleton->getLODLevel() > 0) {
+        kinematics::forwardSolverReduced(posture, skeleton->getBonePointer(0));
+    } else {
+        kinematics::forwardSolverBatch(posture, skeleton.get());
+    }
+}
+
+void Motion::clearCache() {
+    warped_frames.fill(-1);
+    key_frames = {-1, -1};
+}
+
+const std::vector<Posture> &Motion::storedPostures(std::vector<Posture> *buffer) const {
+    if (!isQuantized()) return postures;
+    buffer->resize(quantized.getFrameNum());
+    for (int i = 0; i < quantized.getFrameNum(); ++i) quantized.getPosture(i, &(*buffer)[i]);
+    return *buffer;
+}
+
+void Motion::warpQuantized(double source_frame, Posture *posture) const {
+    int lower = static_cast<int>(source_frame);
+    double t = source_frame - lower;
+    if (t == 0.0 || lower + 1 >= quantized.getFrameNum()) {
+        quantized.getPosture(lower, posture);
+        return;
+    }
+    quantized.getPosture(lower, &dequantized_postures[0]);
+    quantized.getPosture(lower + 1, &dequantized_postures[1]);
+    kinematics::interpolatePosture(dequantized_postures[0], dequantized_postures[1], t, posture);
+}
+
+Motion Motion::resample(const kinematics::ResampleOptions &options) const {
+    std::vector<Posture> buffer;
+    const std::vector<Posture> &source = storedPostures(&buffer);
+    std::vector<Posture> resampled;
+    if (time_map) {
+        std::vector<Posture> warped;
+        kinematics::warpPostures(source, time_map, &warped);
+        kinematics::resample(warped, frame_rate, options, &resampled);
+    } else {
+        kinematics::resample(source, frame_rate, options, &resampled);
+    }
+    return Motion(std::move(resampled), std::make_unique<Skeleton>(*skeleton), options.target_rate);
+}
+
+Motion Motion::filter(const kinematics::FilterOptions &options) const {
+    Motion filtered(std::vector<Posture>(), std::make_unique<Skeleton>(*skeleton), frame_rate);
+    filter(options, &filtered);
+    return filtered;
+}
+
+void Motion::filter(const kinematics::FilterOptions &options, Motion *filtered) const {
+    std::vector<Posture> buffer;
+    const std::vector<Posture> &source = storedPostures(&buffer);
+    if (filtered->isQuantized()) filtered->quantized = kinematics::QuantizedPostures();
+    if (time_map) {
+        std::vector<Posture> warped;
+        kinematics::warpPostures(source, time_map, &warped);
+        kinematics::filterPostures(warped, frame_rate, options, &filtered->postures);
+    } else {
+        kinematics::filterPostures(source, frame_rate, options, &filtered->postures);
+    }
+    filtered->frame_rate = frame_rate;
+    filtered->time_map = nullptr;
+    filtered->clearCache();
+}
+
+Motion Motion::extractRootMotion(const kinematics::RootMotionOptions &options,
+                                 kinematics::RootTrajectory *trajectory) const {
+    std::vector<Posture> buffer;
+    const std::vector<Posture> &source = storedPostures(&buffer);
+    std::vector<Posture> in_place;
+    if (time_map) {
+        kinematics::warpPostures(source, time_map, &in_place);
+    } else {
+        in_place = source;
+    }
+    kinematics::extractRootMotion(skeleton.get(), frame_rate, options, &in_place, trajectory);
+    return Motion(std::move(in_place), std::make_unique<Skeleton>(*skeleton), frame_rate);
+}
+
+kinematics::CompressedMotion Motion::compress(const kinematics::CompressionOptions &options) const {
+    std::vector<Posture> buffer;
+    const std::vector<Posture> &source = storedPostures(&buffer);
+    if (!time_map) return kinematics::CompressedMotion(skeleton.get(), source, frame_rate, options);
+    std::vector<Posture> warped;
+    kinematics::warpPostures(source, time_map, &warped);
+    return kinematics::CompressedMotion(skeleton.get(), warped, frame_rate, options);
+}
+
+void Motion::timeWarper(int oldframe, int newframe) { setTimeMap(kinematics::makeTimeWarp(oldframe, newframe)); }
+
+void Motion::setTimeMap(kinematics::TimeMap map) {
+    time_map = std::move(map);
+    clearCache();
+}
 
 bool Motion::readAMCFile(const util::fs::path &file_name) {
-    // Open AMC file
-    std::ifstream input_stream(file_name);
-    // Check if file successfully opened
-    if (!input_stream) {
+    AMCReader reader;
+    if (!reader.open(file_name, skeleton.get())) {
         std::cerr << "Failed to open " << file_name << std::endl;
         return false;
     }
-    // There are (NUM_BONES_IN_ASF_FILE - 2) moving bones and 2 dummy bones (lhipjoint and rhipjoint)
-    int movable_bones = skeleton->getMovableBoneNum();
-    // Ignore header
-    input_stream.ignore(1024, '\n');
-    input_stream.ignore(1024, '\n');
-    input_stream.ignore(1024, '\n');
-    int frame_num;
-    std::string bone_name;
-    while (input_stream >> frame_num) {
-        auto &&current_posture = postures.emplace_back(skeleton->getBoneNum());
-        for (int i = 0; i < movable_bones; ++i) {
-            input_stream >> bone_name;
-            const Bone &bone = *skeleton->getBonePointer(bone_name);
-            int bone_idx = bone.idx;
-            Eigen::Vector4d bone_rotation = Eigen::Vector4d::Zero();
-            Eigen::Vector4d bone_translation = Eigen::Vector4d::Zero();
-            if (bone.doftx) {
-                input_stream >> bone_translation[0];
-            }
-            if (bone.dofty) {
-                input_stream >> bone_translation[1];
-            }
-            if (bone.doftz) {
-                input_stream >> bone_translation[2];
-            }
-            if (bone.dofrx) {
-                input_stream >> bone_rotation[0];
-            }
-            if (bone.dofry) {
-                input_stream >> bone_rotation[1];
-            }
-            if (bone.dofrz) {
-                input_stream >> bone_rotation[2];
-            }
-            current_posture.bone_rotations[bone_idx] = std::move(bone_rotation);
-            current_posture.bone_translations[bone_idx] = std::move(bone_translation);
-            if (bone_idx == 0) {
-                current_posture.bone_translations[bone_idx] *= skeleton->getScale();
-            }
+    // New frames are appended to full precision postures
+    dequantize();
+    std::size_t first_frame = postures.size();
+    for (Posture posture; reader.next(&posture);) postures.emplace_back(std::move(posture));
+    clearCache();
+    std::cout << postures.size() - first_frame << " samples in " << file_name.string() << " are read" << std::endl;
+    return true;
+}
+
+bool Motion::readClipFile(const util::fs::path &file_name) {
+    ClipDecoder decoder;
+    if (!decoder.open(file_name)) {
+        std::cerr << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    if (decoder.getBoneNum() != skeleton->getBoneNum()) {
+        std::cerr << file_name << " does not match the skeleton" << std::endl;
+        return false;
+    }
+    quantized = kinematics::QuantizedPostures();
+    postures.resize(decoder.getFrameNum());
+    for (Posture &posture : postures) {
+        if (!decoder.next(&posture)) {
+            std::cerr << file_name << " is truncated" << std::endl;
+            postures.clear();
+            return false;
         }
     }
-    input_stream.close();
-    std::cout << frame_num << " samples in " << file_name.string() << " are read" << std::endl;
+    frame_rate = decoder.getFrameRate();
+    clearCache();
+    std::cout << postures.size() << " samples in " << file_name.string() << " are read" << std::endl;
     return true;
 }
+
+bool Motion::writeClipFile(const util::fs::path &file_name) const {
+    std::vector<Posture> buffer;
+    // Root translations were scaled after parsing, the scale lets them be coded as decimals too
+    return acclaim::writeClipFile(file_name, storedPostures(&buffer), frame_rate, skeleton->getScale());
+}
+
+void Motion::appendPostures(const std::vector<Posture> &more) {
+    dequantize();
+    postures.insert(postures.end(), more.begin(), more.end());
+    // Warped frames near the old end were clamped to it
+    clearCache();
+}
+
+void Motion::quantize() {
+    if (isQuantized() || postures.empty()) return;
+    quantized = kinematics::QuantizedPostures(skeleton.get(), postures);
+    std::vector<Posture>().swap(postures);
+    clearCache();
+}
+
+void Motion::dequantize() {
+    if (!isQuantized()) return;
+    storedPostures(&postures);
+    quantized = kinematics::QuantizedPostures();
+    clearCache();
+}
+
+bool Motion::isQuantized() const { return quantized.getFrameNum() > 0; }
+
+double Motion::getQuantizationError() const { return quantized.getError(); }
 }  // namespace acclaim
@@ -9,15 +9,20 @@ Posture::Posture(const std::size_t size) noexcept
     : bone_rotations(size, Eigen::Vector4d::Zero()), bone_translations(size, Eigen::Vector4d::Zero()) {}
 
 Posture::Posture(const Posture &other) noexcept
-    : bone_rotations(other.bone_rotations), bone_translations(other.bone_translations) {}
+    : bone_rotations(other.bone_rotations),
+      bone_translations(other.bone_translations),
+      bone_quaternions(other.bone_quaternions) {}
 
 Posture::Posture(Posture &&other) noexcept
-    : bone_rotations(std::move(other.bone_rotations)), bone_translations(std::move(other.bone_translations)) {}
+    : bone_rotations(std::move(other.bone_rotations)),
+      bone_translations(std::move(other.bone_translations)),
+      bone_quaternions(std::move(other.bone_quaternions)) {}
 
 Posture &Posture::operator=(const Posture &other) noexcept {
     if (this != &other) {
         bone_rotations = other.bone_rotations;
         bone_translations = other.bone_translations;
+        bone_quaternions = other.bone_quaternions;
     }
     return *this;
 }
@@ -25,6 +30,7 @@ Posture &Posture::operator=(Posture &&other) noexcept {
     if (this != &other) {
         bone_rotations = std::move(other.bone_rotations);
         bone_translations = std::move(other.bone_translations);
+        bone_quaternions = std::move(other.bone_quaternions);
     }
     return *this;
 }
@@ -1,5 +1,6 @@
 #include "acclaim/skeleton.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -37,10 +38,15 @@ Skeleton::Skeleton(const util::fs::path &file_name, const double _scale) noexcep
     computeRotation2ParentCoord(&bones[0]);
 
     setBoneGraphics();
+    generateReducedSkeleton();
 }
 
 Skeleton::Skeleton(const Skeleton &other) noexcept
-    : scale(other.scale), movableBones(other.movableBones), bones(other.bones), bone_graphics(other.bone_graphics) {
+    : scale(other.scale),
+      movableBones(other.movableBones),
+      lod_level(other.lod_level),
+      bones(other.bones),
+      bone_graphics(other.bone_graphics) {
     for (std::size_t i = 0; i < bones.size(); ++i) {
         if (bones[i].parent != nullptr) {
             bones[i].parent = &bones[other.bones[i].parent->idx];
@@ -57,6 +63,7 @@ Skeleton::Skeleton(const Skeleton &other) noexcept
 Skeleton::Skeleton(Skeleton &&other) noexcept
     : scale(other.scale),
       movableBones(other.movableBones),
+      lod_level(other.lod_level),
       bones(std::move(other.bones)),
       bone_graphics(std::move(other.bone_graphics)) {}
 
@@ -64,6 +71,7 @@ Skeleton &Skeleton::operator=(const Skeleton &other) noexcept {
     if (this != &other) {
         scale = other.scale;
         movableBones = other.movableBones;
+        lod_level = other.lod_level;
         bones = other.bones;
         // We need to reset all pointer in bones
         for (std::size_t i = 0; i < bones.size(); ++i) {
@@ -86,6 +94,7 @@ Skeleton &Skeleton::operator=(Skeleton &&other) noexcept {
     if (this != &other) {
         scale = other.scale;
         movableBones = other.movableBones;
+        lod_level = other.lod_level;
         bones = std::move(other.bones);
         bone_graphics = std::move(other.bone_graphics);
     }
@@ -116,6 +125,7 @@ void Skeleton::setBoneColor(const Eigen::Vector4f &boneColor) {
 void Skeleton::setModelMatrices() {
     for (int i = 0; i < bone_graphics.size(); ++i) {
         auto &&bone = bones[i];
+        if (lod_level > 0 && bone.collapsed) continue;
         Eigen::Vector4d trans = 0.5 * (bone.start_position + bone.end_position);
         Eigen::Affine3d model = bone.global_facing;
         model.prerotate(bone.rotation.rotation()).pretranslate(trans.head<3>());
@@ -125,10 +135,46 @@ void Skeleton::setModelMatrices() {
 
 void Skeleton::render(graphics::Program *program) {
     for (int i = 0; i < bone_graphics.size(); ++i) {
+        if (lod_level > 0 && bones[i].collapsed) continue;
         bone_graphics[i].render(program);
     }
 }
 
+void Skeleton::generateReducedSkeleton(const double length_ratio) {
+    double max_length = 0.0;
+    for (auto &&bone : bones) {
+        bone.collapsed = false;
+        max_length = std::max(max_length, bone.length);
+    }
+    const double threshold = length_ratio * max_length;
+    for (auto &&bone : bones) {
+        // Start from every leaf and walk up while the chain does not branch
+        if (bone.child != nullptr) continue;
+        double chain_length = 0.0;
+        std::vector<Bone *> chain;
+        for (Bone *current = &bone; current->parent != nullptr; current = current->parent) {
+            chain_length += current->length;
+            if (chain_length > threshold) break;
+            chain.push_back(current);
+            // Parent has more than one child, it is a branch point
+            if (current->parent->child != current || current->sibling != nullptr) break;
+        }
+        for (Bone *collapsed : chain) collapsed->collapsed = true;
+    }
+}
+
+int Skeleton::getReducedBoneNum() const {
+    int count = 0;
+    for (auto &&bone : bones) {
+        if (!bone.collapsed) ++count;
+    }
+    return count;
+}
+
+int Skeleton::getLODLevel() const { return lod_level; }
+
+void Skeleton::setLODLevel(const int level) { lod_level = level; }
+
 bool Skeleton::readASFFile(const util::fs::path &file_name) {
     std::ifstream input_stream(file_name);
     if (!input_stream) {
@@ -1,31 +1,61 @@
 #include "graphics/shader.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <iostream>
+#include <vector>
 
 namespace graphics {
+namespace {
+// Cache files start with this and the binary format, a changed layout gets a new magic
+constexpr char binaryMagic[8] = {'F', 'K', 'P', 'R', 'O', 'G', '0', '1'};
+
+// FNV-1a
+std::uint64_t hashString(const char* text, std::uint64_t hash = 14695981039346656037ull) {
+    for (; *text != '\0'; ++text) hash = (hash ^ static_cast<unsigned char>(*text)) * 1099511628211ull;
+    // Terminator too, so that consecutive strings cannot shift into each other
+    return hash * 1099511628211ull;
+}
+
+// Binaries are only valid for the driver that made them, it is part of the key with the sources
+util::fs::path binaryCacheFile(const util::fs::path& cacheFolder, const std::string& vertexSource,
+                               const std::string& fragmentSource) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        hash = hashString(reinterpret_cast<const char*>(glGetString(name)), hash);
+    }
+    hash = hashString(vertexSource.c_str(), hash);
+    hash = hashString(fragmentSource.c_str(), hash);
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return cacheFolder / name;
+}
+
+bool linkStatus(GLuint program) {
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success == GL_TRUE;
+}
+}  // namespace
 
 Shader::Shader(util::fs::path filePath, GLenum shaderType) {
     id = glCreateShader(shaderType);
-    auto shaderCode = loadFromFile(filePath);
-    auto shaderCodePointer = shaderCode.c_str();
-    glShaderSource(id, 1, &shaderCodePointer, nullptr);
-    glCompileShader(id);
-    GLint success;
-    GLchar infoLog[1024];
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(id, 1024, nullptr, infoLog);
-        puts("Shader compilation error!");
-        puts(infoLog);
-    }
+    compile(readSource(filePath));
+}
+
+Shader::Shader(GLenum shaderType, const std::string& source) {
+    id = glCreateShader(shaderType);
+    compile(source);
 }
 
 Shader::~Shader() { glDeleteShader(id); }
 
 GLuint Shader::getID() const { return id; }
 
-std::string Shader::loadFromFile(util::fs::path filename) {
-    std::ifstream shaderFile(filename);
+std::string Shader::readSource(const util::fs::path& filePath) {
+    std::ifstream shaderFile(filePath);
     if (!shaderFile.is_open()) {
         puts("Failed to open shader file!");
         return "";
@@ -35,6 +65,20 @@ std::string Shader::loadFromFile(util::fs::path filename) {
     return shaderCode;
 }
 
+void Shader::compile(const std::string& shaderCode) {
+    auto shaderCodePointer = shaderCode.c_str();
+    glShaderSource(id, 1, &shaderCodePointer, nullptr);
+    glCompileShader(id);
+    GLint success;
+    GLchar infoLog[1024];
+    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(id, 1024, nullptr, infoLog);
+        puts("Shader compilation error!");
+        puts(infoLog);
+    }
+}
+
 Program::Program() { id = glCreateProgram(); }
 
 Program::~Program() { glDeleteProgram(id); }
@@ -51,6 +95,54 @@ void Program::link() {
     }
 }
 
+bool Program::linkCached(const util::fs::path& cacheFolder, const std::string& vertexSource,
+                         const std::string& fragmentSource) {
+    GLint formatNum = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatNum);
+    util::fs::path cacheFile = binaryCacheFile(cacheFolder, vertexSource, fragmentSource);
+    std::ifstream input(cacheFile, std::ios::binary);
+    char magic[sizeof(binaryMagic)];
+    GLenum format;
+    if (formatNum > 0 && input.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), binaryMagic) &&
+        input.read(reinterpret_cast<char*>(&format), sizeof(format))) {
+        std::vector<char> binary((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        glProgramBinary(id, format, binary.data(), static_cast<GLsizei>(binary.size()));
+        if (linkStatus(id)) return true;
+        // Drivers may reject binaries of another version, start over with a clean program
+        std::cerr << "Cached shader program " << cacheFile.string() << " rejected, compiling from source" << std::endl;
+        glDeleteProgram(id);
+        id = glCreateProgram();
+    }
+    input.close();
+    Shader vertexShader(GL_VERTEX_SHADER, vertexSource);
+    Shader fragmentShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (formatNum > 0) glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    attachLinkShader(vertexShader, fragmentShader);
+    if (formatNum == 0 || !linkStatus(id)) return false;
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    std::vector<char> binary(length);
+    glGetProgramBinary(id, length, &length, &format, binary.data());
+    if (length <= 0) return false;
+    // Written next to the final name and renamed, a half written file is never picked up
+    std::error_code error;
+    util::fs::create_directories(cacheFolder, error);
+    util::fs::path temporaryFile = cacheFile;
+    temporaryFile += ".tmp";
+    std::ofstream output(temporaryFile, std::ios::binary);
+    output.write(binaryMagic, sizeof(binaryMagic));
+    output.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    output.write(binary.data(), length);
+    output.close();
+    if (output) {
+        util::fs::rename(temporaryFile, cacheFile, error);
+    } else {
+        std::cerr << "Failed to write " << cacheFile.string() << std::endl;
+        util::fs::remove(temporaryFile, error);
+    }
+    return false;
+}
+
 GLuint Program::getID() const { return id; }
 
 int Program::getUniformLocation(const char* name) const { return glGetUniformLocation(id, name); }
@@ -13,6 +13,16 @@ namespace graphics {
 
 GLuint TextureBase::freeIndex = 0;
 
+Image loadImage(const util::fs::path &filePath, bool flip) {
+    Image image;
+    // The flag of stb_image is global, the thread local one lets images be decoded in parallel
+    stbi_set_flip_vertically_on_load_thread(flip);
+    image.data = {stbi_load(filePath.string().c_str(), &image.width, &image.height, &image.nChannels, 0),
+                  stbi_image_free};
+    if (image.data == nullptr) std::cerr << filePath.string() << " not found!" << std::endl;
+    return image;
+}
+
 TextureBase::TextureBase() noexcept {
     glGenTextures(1, &id);
     index = freeIndex++;
@@ -22,33 +32,24 @@ TextureBase::~TextureBase() { glDeleteTextures(1, &id); }
 
 GLuint TextureBase::getIndex() const { return index; }
 
-Texture::Texture(const char *fileName) {
-    stbi_set_flip_vertically_on_load(true);
-    loadTexture(fileName);
-}
+Texture::Texture(const char *fileName) { loadTexture(loadImage(fileName, true)); }
 
-Texture::Texture(util::fs::path filePath) {
-    stbi_set_flip_vertically_on_load(true);
-    loadTexture(filePath.string().c_str());
-}
+Texture::Texture(util::fs::path filePath) { loadTexture(loadImage(filePath, true)); }
 
-void Texture::loadTexture(const char *fileName) {
-    int width, height, nChannels;
-    stbi_uc *data = stbi_load(fileName, &width, &height, &nChannels, 0);
-    if (data == nullptr) {
-        std::cerr << fileName << " not found!" << std::endl;
-        return;
-    }
-    int colorFormat = (nChannels == 4) ? GL_RGBA : GL_RGB;
+Texture::Texture(const Image &image) { loadTexture(image); }
+
+void Texture::loadTexture(const Image &image) {
+    if (image.data == nullptr) return;
+    int colorFormat = (image.nChannels == 4) ? GL_RGBA : GL_RGB;
     glActiveTexture(GL_TEXTURE0 + index);
     glBindTexture(GL_TEXTURE_2D, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, colorFormat, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, image.width, image.height, 0, colorFormat, GL_UNSIGNED_BYTE,
+                 image.data.get());
     glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
 }
 
 ShadowMapTexture::ShadowMapTexture(unsigned int size) {
@@ -83,24 +84,20 @@ void ShadowMapTexture::bindFrameBuffer() const { glBindFramebuffer(GL_FRAMEBUFFE
 void ShadowMapTexture::unbindFrameBuffer() const { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
 
 CubeTexture::CubeTexture(const std::array<const char *, 6> &fileName) {
-    stbi_set_flip_vertically_on_load(false);
-    loadTexture(fileName);
+    std::array<Image, 6> images;
+    for (int i = 0; i < 6; ++i) images[i] = loadImage(fileName[i], false);
+    loadTexture(images);
 }
 
 CubeTexture::CubeTexture(const std::array<util::fs::path, 6> &fileName) {
-    stbi_set_flip_vertically_on_load(false);
-    std::array<std::string, 6> stringPath;
-    std::array<const char *, 6> cstringPath;
-    for (int i = 0; i < 6; ++i) {
-        stringPath[i] = fileName[i].string();
-        cstringPath[i] = stringPath[i].c_str();
-    }
-    loadTexture(cstringPath);
+    std::array<Image, 6> images;
+    for (int i = 0; i < 6; ++i) images[i] = loadImage(fileName[i], false);
+    loadTexture(images);
 }
 
-void CubeTexture::loadTexture(const std::array<const char *, 6> &fileName) {
-    int width = 0, height = 0, nChannels = 0;
-    stbi_uc *data = nullptr;
+CubeTexture::CubeTexture(const std::array<Image, 6> &images) { loadTexture(images); }
+
+void CubeTexture::loadTexture(const std::array<Image, 6> &images) {
     glActiveTexture(GL_TEXTURE0 + index);
     glBindTexture(GL_TEXTURE_CUBE_MAP, id);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -109,13 +106,9 @@ void CubeTexture::loadTexture(const std::array<const char *, 6> &fileName) {
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     for (int i = 0; i < 6; ++i) {
-        data = stbi_load(fileName[i], &width, &height, &nChannels, 0);
-        if (data == nullptr) {
-            std::cerr << fileName[i] << " not found!" << std::endl;
-            return;
-        }
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
+        if (images[i].data == nullptr) return;
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, images[i].width, images[i].height, 0, GL_RGB,
+                     GL_UNSIGNED_BYTE, images[i].data.get());
     }
 }
 }  // namespace graphics
@@ -0,0 +1,191 @@
+#include "simulation/alignment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+#include "util/simd.h"
+
+namespace kinematics {
+namespace {
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+// Columns [lo[i], hi[i]] of the motion searched for reference frame i
+struct Window {
+    std::vector<int> lo, hi;
+};
+
+// Make sure the window contains both corners and every cell in it can be reached from (0, 0)
+void closeWindow(int columns, Window* window) {
+    int rows = static_cast<int>(window->lo.size());
+    window->lo[0] = 0;
+    window->hi[rows - 1] = columns - 1;
+    for (int i = 1; i < rows; ++i) {
+        window->lo[i] = std::clamp(window->lo[i], window->lo[i - 1], window->hi[i - 1] + 1);
+        window->hi[i] = std::max(window->hi[i], window->hi[i - 1]);
+    }
+}
+
+// Sakoe-Chiba band around the diagonal
+Window bandWindow(int rows, int columns, double band_ratio, int radius) {
+    Window window;
+    window.lo.resize(rows);
+    window.hi.resize(rows);
+    double half_width = std::max<double>(radius, band_ratio * columns);
+    for (int i = 0; i < rows; ++i) {
+        double center = rows > 1 ? double(i) * (columns - 1) / (rows - 1) : 0.0;
+        window.lo[i] = std::max(0, static_cast<int>(std::floor(center - half_width)));
+        window.hi[i] = std::min(columns - 1, static_cast<int>(std::ceil(center + half_width)));
+    }
+    closeWindow(columns, &window);
+    return window;
+}
+
+// Cells of the coarse path at twice the resolution, widened by radius in both directions
+Window projectPath(const std::vector<std::pair<int, int>>& path, int rows, int columns, int radius) {
+    std::vector<int> lo(rows, columns), hi(rows, -1);
+    for (const std::pair<int, int>& cell : path) {
+        for (int i = 2 * cell.first; i <= std::min(2 * cell.first + 1, rows - 1); ++i) {
+            lo[i] = std::min(lo[i], 2 * cell.second);
+            hi[i] = std::max(hi[i], std::min(2 * cell.second + 1, columns - 1));
+        }
+    }
+    Window window;
+    window.lo.resize(rows);
+    window.hi.resize(rows);
+    for (int i = 0; i < rows; ++i) {
+        int first = std::max(0, i - radius), last = std::min(rows - 1, i + radius);
+        int window_lo = *std::min_element(lo.begin() + first, lo.begin() + last + 1);
+        int window_hi = *std::max_element(hi.begin() + first, hi.begin() + last + 1);
+        window.lo[i] = std::max(0, window_lo - radius);
+        window.hi[i] = std::min(columns - 1, window_hi + radius);
+    }
+    closeWindow(columns, &window);
+    return window;
+}
+
+// Dynamic time warping restricted to the window, steps are (1, 0), (0, 1) and (1, 1)
+std::vector<std::pair<int, int>> windowedDTW(const MotionFeatures& reference, const MotionFeatures& motion,
+                                             const Window& window) {
+    int rows = reference.frame_num;
+    std::vector<std::size_t> offsets(rows + 1, 0);
+    for (int i = 0; i < rows; ++i) offsets[i + 1] = offsets[i] + (window.hi[i] - window.lo[i] + 1);
+    std::vector<double> cost(offsets[rows]);
+    auto at = [&](int i, int j) {
+        if (i < 0 || j < window.lo[i] || j > window.hi[i]) return infinity;
+        return cost[offsets[i] + (j - window.lo[i])];
+    };
+    const util::simd::Kernels& kernels = util::simd::kernels();
+    for (int i = 0; i < rows; ++i) {
+        double* row = &cost[offsets[i]];
+        int lo = window.lo[i];
+        kernels.squaredDistances(reference.getFrame(i), motion.getFrame(lo), reference.dimension, row,
+                                 window.hi[i] - lo + 1);
+        for (int j = lo; j <= window.hi[i]; ++j) {
+            double best = (i == 0 && j == 0) ? 0.0 : std::min({at(i - 1, j), at(i, j - 1), at(i - 1, j - 1)});
+            row[j - lo] = std::sqrt(row[j - lo]) + best;
+        }
+    }
+    // Walk back from the last cell, prefer diagonal steps on ties
+    std::vector<std::pair<int, int>> path;
+    int i = rows - 1, j = motion.frame_num - 1;
+    path.emplace_back(i, j);
+    while (i > 0 || j > 0) {
+        double diagonal = at(i - 1, j - 1), up = at(i - 1, j), left = at(i, j - 1);
+        if (diagonal <= up && diagonal <= left) {
+            --i;
+            --j;
+        } else if (up <= left) {
+            --i;
+        } else {
+            --j;
+        }
+        path.emplace_back(i, j);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+}  // namespace
+
+std::vector<std::pair<int, int>> alignFeatures(const MotionFeatures& reference, const MotionFeatures& motion,
+                                               const AlignmentOptions& options) {
+    if (reference.frame_num == 0 || motion.frame_num == 0) return {};
+    // Feature pyramids, level 0 is the input
+    std::deque<MotionFeatures> storage;
+    std::vector<const MotionFeatures*> reference_levels = {&reference}, motion_levels = {&motion};
+    while (std::min(reference_levels.back()->frame_num, motion_levels.back()->frame_num) > options.coarsest_frames) {
+        downsampleFeatures(*reference_levels.back(), &storage.emplace_back());
+        reference_levels.push_back(&storage.back());
+        downsampleFeatures(*motion_levels.back(), &storage.emplace_back());
+        motion_levels.push_back(&storage.back());
+    }
+    std::size_t coarsest = reference_levels.size() - 1;
+    std::vector<std::pair<int, int>> path =
+        windowedDTW(*reference_levels[coarsest], *motion_levels[coarsest],
+                    bandWindow(reference_levels[coarsest]->frame_num, motion_levels[coarsest]->frame_num,
+                               options.band_ratio, options.radius));
+    // Refine towards the full frame rate
+    for (std::size_t i = coarsest; i-- > 0;) {
+        Window window = projectPath(path, reference_levels[i]->frame_num, motion_levels[i]->frame_num, options.radius);
+        path = windowedDTW(*reference_levels[i], *motion_levels[i], window);
+    }
+    return path;
+}
+
+std::vector<KeyframePair> pathToKeyframes(const std::vector<std::pair<int, int>>& path, double tolerance) {
+    if (path.empty()) return {};
+    // One motion frame per reference frame (the first one on the path)
+    int rows = path.back().first + 1;
+    std::vector<int> columns(rows, -1);
+    for (const std::pair<int, int>& cell : path) {
+        if (columns[cell.first] < 0) columns[cell.first] = cell.second;
+    }
+    // Douglas-Peucker simplification of the curve (i, columns[i])
+    std::vector<bool> keep(rows, false);
+    keep[0] = keep[rows - 1] = true;
+    std::vector<std::pair<int, int>> segments;
+    if (rows > 2) segments.emplace_back(0, rows - 1);
+    while (!segments.empty()) {
+        auto [first, last] = segments.back();
+        segments.pop_back();
+        double slope = double(columns[last] - columns[first]) / (last - first);
+        int farthest = -1;
+        double farthest_distance = tolerance;
+        for (int i = first + 1; i < last; ++i) {
+            double distance = std::abs(columns[first] + slope * (i - first) - columns[i]);
+            if (distance > farthest_distance) {
+                farthest = i;
+                farthest_distance = distance;
+            }
+        }
+        if (farthest < 0) continue;
+        keep[farthest] = true;
+        if (farthest - first > 1) segments.emplace_back(first, farthest);
+        if (last - farthest > 1) segments.emplace_back(farthest, last);
+    }
+    // Time maps need both frames strictly increasing
+    std::vector<KeyframePair> keyframes;
+    for (int i = 0; i < rows; ++i) {
+        if (!keep[i]) continue;
+        if (!keyframes.empty() && columns[i] <= keyframes.back().keyframe_old) continue;
+        keyframes.push_back({columns[i], i});
+    }
+    return keyframes;
+}
+
+std::vector<KeyframePair> alignMotions(acclaim::Motion* reference, acclaim::Motion* motion,
+                                       const AlignmentOptions& options) {
+    MotionFeatures reference_features, motion_features;
+    extractJointPositions(reference, &reference_features);
+    extractJointPositions(motion, &motion_features);
+    return pathToKeyframes(alignFeatures(reference_features, motion_features, options), options.keyframe_tolerance);
+}
+
+PiecewiseTimeMap makeTimeMap(const std::vector<KeyframePair>& keyframes,
+                             PiecewiseTimeMap::Interpolation interpolation) {
+    PiecewiseTimeMap time_map(interpolation);
+    for (const KeyframePair& keyframe : keyframes) time_map.addKey(keyframe.keyframe_new, keyframe.keyframe_old);
+    return time_map;
+}
+}  // namespace kinematics
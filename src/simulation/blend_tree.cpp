@@ -0,0 +1,187 @@
+#include "simulation/blend_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+#include "acclaim/motion.h"
+#include "simulation/kinematics.h"
+#include "util/helper.h"
+#include "util/simd.h"
+
+namespace kinematics {
+namespace {
+void markSubtree(const acclaim::Bone* bone, std::vector<double>* mask) {
+    if (bone == nullptr) return;
+    (*mask)[bone->idx] = 1.0;
+    markSubtree(bone->child, mask);
+    markSubtree(bone->sibling, mask);
+}
+}  // namespace
+
+std::vector<double> subtreeMask(acclaim::Skeleton* skeleton, const std::string& bone_name) {
+    std::vector<double> mask(skeleton->getBoneNum(), 0.0);
+    const acclaim::Bone* bone = skeleton->getBonePointer(bone_name);
+    if (bone == nullptr) {
+        std::cerr << "Bone " << bone_name << " not found, the mask is empty" << std::endl;
+        return mask;
+    }
+    mask[bone->idx] = 1.0;
+    markSubtree(bone->child, &mask);
+    return mask;
+}
+
+BlendTree::BlendTree(int _bone_num, bool _euler_angles) noexcept
+    : bone_num(_bone_num),
+      euler_angles(_euler_angles),
+      rest_pose(_bone_num),
+      weights(_bone_num, 0.0),
+      identity(_bone_num, Eigen::Quaterniond::Identity()),
+      delta(_bone_num, Eigen::Quaterniond::Identity()),
+      scaled_delta(_bone_num, Eigen::Quaterniond::Identity()) {
+    rest_pose.bone_quaternions.assign(bone_num, Eigen::Quaterniond::Identity());
+}
+
+int BlendTree::addClip(acclaim::Motion* motion) {
+    if (motion == nullptr) {
+        std::cerr << "Clip node needs a motion" << std::endl;
+        return -1;
+    }
+    Node node;
+    node.type = NodeType::Clip;
+    node.motion = motion;
+    return addNode(std::move(node));
+}
+
+int BlendTree::addBlend(int from, int to, double weight, const std::vector<double>& bone_mask) {
+    if (!isNode(from) || !isNode(to)) {
+        std::cerr << "Blend inputs must be nodes added before" << std::endl;
+        return -1;
+    }
+    if (!bone_mask.empty() && bone_mask.size() != static_cast<std::size_t>(bone_num)) {
+        std::cerr << "Bone mask needs one weight per bone" << std::endl;
+        return -1;
+    }
+    Node node;
+    node.type = NodeType::Blend;
+    node.inputs[0] = from;
+    node.inputs[1] = to;
+    node.weight = weight;
+    node.mask = bone_mask.empty() ? std::vector<double>(bone_num, 1.0) : bone_mask;
+    return addNode(std::move(node));
+}
+
+int BlendTree::addAdditive(int base, int layer, double reference_seconds, double weight) {
+    if (!isNode(base)) {
+        std::cerr << "Additive base must be a node added before" << std::endl;
+        return -1;
+    }
+    if (!isNode(layer) || nodes[layer].type != NodeType::Clip) {
+        std::cerr << "Additive layer must be a clip node" << std::endl;
+        return -1;
+    }
+    Node node;
+    node.type = NodeType::Additive;
+    node.inputs[0] = base;
+    node.inputs[1] = layer;
+    node.weight = weight;
+    // A layer clip without frames yet keeps the rest pose as reference
+    acclaim::Posture reference = rest_pose;
+    sampleClip(nodes[layer].motion, reference_seconds, &reference);
+    node.reference_rotations.resize(bone_num);
+    for (int i = 0; i < bone_num; ++i) node.reference_rotations[i] = reference.bone_quaternions[i].conjugate();
+    node.reference_translations = reference.bone_translations;
+    return addNode(std::move(node));
+}
+
+void BlendTree::setTime(int node_idx, double seconds) {
+    if (isNode(node_idx)) nodes[node_idx].time = seconds;
+}
+
+void BlendTree::setWeight(int node_idx, double weight) {
+    if (isNode(node_idx)) nodes[node_idx].weight = weight;
+}
+
+int BlendTree::getNodeNum() const { return static_cast<int>(nodes.size()); }
+
+const acclaim::Posture& BlendTree::evaluate() {
+    if (nodes.empty()) return rest_pose;
+    for (Node& node : nodes) {
+        switch (node.type) {
+            case NodeType::Clip:
+                sampleClip(node.motion, node.time, &node.output);
+                break;
+            case NodeType::Blend:
+                evaluateBlend(&node);
+                break;
+            case NodeType::Additive:
+                evaluateAdditive(&node);
+                break;
+        }
+    }
+    // Inner nodes only pass quaternions on, Euler angles are needed for the result alone
+    acclaim::Posture& output = nodes.back().output;
+    if (euler_angles) {
+        for (int i = 0; i < bone_num; ++i) output.bone_rotations[i] = util::toDegreeZYX(output.bone_quaternions[i]);
+    }
+    return output;
+}
+
+void BlendTree::sampleClip(acclaim::Motion* motion, double seconds, acclaim::Posture* posture) {
+    // Clips still loading have no frames yet, the node holds its pose until they arrive
+    int total_frames = motion->getFrameNum();
+    if (total_frames == 0) return;
+    double duration = motion->getDuration();
+    seconds = std::fmod(seconds, duration);
+    if (seconds < 0.0) seconds += duration;
+    double frame = std::min(seconds * motion->getFrameRate(), double(total_frames - 1));
+    int lower = static_cast<int>(frame);
+    int upper = std::min(lower + 1, total_frames - 1);
+    const acclaim::Posture& from = motion->getPosture(lower);
+    // Postures of another skeleton would be read past their last bone
+    if (from.bone_rotations.size() != posture->bone_rotations.size()) return;
+    interpolatePosture(from, motion->getPosture(upper), frame - lower, posture, false);
+}
+
+bool BlendTree::isNode(int node_idx) const { return node_idx >= 0 && node_idx < getNodeNum(); }
+
+int BlendTree::addNode(Node&& node) {
+    node.output = rest_pose;
+    nodes.emplace_back(std::move(node));
+    return getNodeNum() - 1;
+}
+
+void BlendTree::evaluateBlend(Node* node) {
+    const acclaim::Posture& from = nodes[node->inputs[0]].output;
+    const acclaim::Posture& to = nodes[node->inputs[1]].output;
+    acclaim::Posture& output = node->output;
+    for (int i = 0; i < bone_num; ++i) weights[i] = node->weight * node->mask[i];
+    util::simd::kernels().blendQuaternions(from.bone_quaternions[0].coeffs().data(),
+                                           to.bone_quaternions[0].coeffs().data(), weights.data(),
+                                           output.bone_quaternions[0].coeffs().data(), bone_num);
+    for (int i = 0; i < bone_num; ++i) {
+        output.bone_translations[i] =
+            from.bone_translations[i] + weights[i] * (to.bone_translations[i] - from.bone_translations[i]);
+    }
+}
+
+void BlendTree::evaluateAdditive(Node* node) {
+    const acclaim::Posture& base = nodes[node->inputs[0]].output;
+    const acclaim::Posture& layer = nodes[node->inputs[1]].output;
+    acclaim::Posture& output = node->output;
+    const util::simd::Kernels& kernels = util::simd::kernels();
+    // delta = reference^-1 * layer, scaled by the weight then applied on top of base
+    kernels.multiplyQuaternions(node->reference_rotations[0].coeffs().data(), layer.bone_quaternions[0].coeffs().data(),
+                                delta[0].coeffs().data(), bone_num);
+    std::fill(weights.begin(), weights.end(), node->weight);
+    kernels.blendQuaternions(identity[0].coeffs().data(), delta[0].coeffs().data(), weights.data(),
+                             scaled_delta[0].coeffs().data(), bone_num);
+    kernels.multiplyQuaternions(base.bone_quaternions[0].coeffs().data(), scaled_delta[0].coeffs().data(),
+                                output.bone_quaternions[0].coeffs().data(), bone_num);
+    for (int i = 0; i < bone_num; ++i) {
+        output.bone_translations[i] =
+            base.bone_translations[i] + node->weight * (layer.bone_translations[i] - node->reference_translations[i]);
+    }
+}
+}  // namespace kinematics
@@ -0,0 +1,152 @@
+#include "simulation/features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+#include "acclaim/motion.h"
+#include "simulation/kinematics.h"
+
+namespace kinematics {
+namespace {
+// FNV-1a over the bytes of the values
+template <typename T>
+std::uint64_t hashValues(const T* values, std::size_t count, std::uint64_t hash) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+    for (std::size_t i = 0; i < count * sizeof(T); ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+}  // namespace
+
+const double* MotionFeatures::getFrame(int frame_idx) const {
+    return values.data() + static_cast<std::size_t>(frame_idx) * dimension;
+}
+
+bool findBones(acclaim::Skeleton* skeleton, const std::vector<std::string>& names, const std::string& clip_name,
+               std::vector<int>* bones) {
+    bones->clear();
+    for (const std::string& name : names) {
+        const acclaim::Bone* bone = skeleton->getBonePointer(name);
+        if (bone == nullptr) {
+            std::cerr << "Bone " << name << " not found in the skeleton of " << clip_name << std::endl;
+            return false;
+        }
+        bones->push_back(bone->idx);
+    }
+    return true;
+}
+
+void extractJointPositions(acclaim::Motion* motion, MotionFeatures* features) {
+    acclaim::Skeleton* skeleton = motion->getSkeleton().get();
+    int total_bones = skeleton->getBoneNum();
+    features->frame_num = motion->getFrameNum();
+    features->dimension = 4 * total_bones;
+    features->values.resize(static_cast<std::size_t>(features->frame_num) * features->dimension);
+    const acclaim::Bone* root = skeleton->getBonePointer(acclaim::Skeleton::root_idx());
+    for (int i = 0; i < features->frame_num; ++i) {
+        forwardSolverBatch(motion->getPosture(i), skeleton);
+        double* frame = features->values.data() + static_cast<std::size_t>(i) * features->dimension;
+        for (int j = 0; j < total_bones; ++j) {
+            Eigen::Map<Eigen::Vector4d>(frame + 4 * j) =
+                skeleton->getBonePointer(j)->end_position - root->start_position;
+        }
+    }
+}
+
+void extractPoseFeatures(acclaim::Motion* motion, const std::vector<int>& bones, MotionFeatures* features) {
+    acclaim::Skeleton* skeleton = motion->getSkeleton().get();
+    int total_bones = static_cast<int>(bones.size());
+    features->frame_num = motion->getFrameNum();
+    features->dimension = 6 * total_bones;
+    features->values.resize(static_cast<std::size_t>(features->frame_num) * features->dimension);
+    const acclaim::Bone* root = skeleton->getBonePointer(acclaim::Skeleton::root_idx());
+    // World positions of the previous frame for velocities
+    std::vector<Eigen::Vector3d> previous(total_bones, Eigen::Vector3d::Zero());
+    std::vector<Eigen::Vector3d> current(total_bones, Eigen::Vector3d::Zero());
+    for (int i = 0; i < features->frame_num; ++i) {
+        forwardSolverBatch(motion->getPosture(i), skeleton);
+        for (int j = 0; j < total_bones; ++j) current[j] = skeleton->getBonePointer(bones[j])->end_position.head<3>();
+        Eigen::Vector3d facing = root->rotation.linear() * Eigen::Vector3d::UnitZ();
+        Eigen::Matrix3d to_character =
+            Eigen::AngleAxisd(-std::atan2(facing.x(), facing.z()), Eigen::Vector3d::UnitY()).toRotationMatrix();
+        Eigen::Vector3d origin = root->start_position.head<3>();
+        double* frame = features->values.data() + static_cast<std::size_t>(i) * features->dimension;
+        for (int j = 0; j < total_bones; ++j) {
+            Eigen::Map<Eigen::Vector3d>(frame + 6 * j) = to_character * (current[j] - origin);
+            Eigen::Map<Eigen::Vector3d>(frame + 6 * j + 3) =
+                i > 0 ? Eigen::Vector3d(to_character * (current[j] - previous[j]) * motion->getFrameRate())
+                      : Eigen::Vector3d::Zero();
+        }
+        std::swap(previous, current);
+    }
+    // Frame 0 has no previous frame, reuse the velocity of frame 1
+    if (features->frame_num > 1) {
+        for (int j = 0; j < total_bones; ++j) {
+            for (int k = 3; k < 6; ++k) {
+                features->values[6 * j + k] = features->values[features->dimension + 6 * j + k];
+            }
+        }
+    }
+}
+
+void poseFeatureScales(const MotionFeatures& features, double position_weight, double velocity_weight,
+                       std::vector<double>* means, std::vector<double>* scales) {
+    int total_frames = std::max(features.frame_num, 1);
+    int dimension = features.dimension;
+    means->assign(dimension, 0.0);
+    scales->assign(dimension, 1.0);
+    std::vector<double> variances(dimension, 0.0);
+    for (int i = 0; i < features.frame_num; ++i) {
+        const double* frame = features.getFrame(i);
+        for (int k = 0; k < dimension; ++k) (*means)[k] += frame[k];
+    }
+    for (double& mean : *means) mean /= total_frames;
+    for (int i = 0; i < features.frame_num; ++i) {
+        const double* frame = features.getFrame(i);
+        for (int k = 0; k < dimension; ++k) variances[k] += (frame[k] - (*means)[k]) * (frame[k] - (*means)[k]);
+    }
+    // Dimension k belongs to the positions (group 0) or the velocities (group 1) of bone k / 6
+    for (int group = 0; group < 2; ++group) {
+        double variance = 0.0;
+        for (int k = 0; k < dimension; ++k) {
+            if ((k % 6) / 3 == group) variance += variances[k];
+        }
+        double deviation = std::sqrt(variance / total_frames / std::max(dimension / 2, 1));
+        double weight = group == 0 ? position_weight : velocity_weight;
+        for (int k = 0; k < dimension; ++k) {
+            if ((k % 6) / 3 == group) (*scales)[k] = deviation > 1e-12 ? weight / deviation : weight;
+        }
+    }
+}
+
+std::uint64_t motionFingerprint(const acclaim::Motion* motion) {
+    acclaim::Skeleton* skeleton = motion->getSkeleton().get();
+    int total_frames = motion->getFrameNum();
+    std::uint64_t hash = hashValues(&total_frames, 1, 14695981039346656037ull);
+    for (int j = 0; skeleton != nullptr && j < skeleton->getBoneNum(); ++j) {
+        const acclaim::Bone* bone = skeleton->getBonePointer(j);
+        hash = hashValues(&bone->length, 1, hash);
+        hash = hashValues(bone->dir.data(), 4, hash);
+    }
+    for (int i = 0; i < total_frames; ++i) {
+        const acclaim::Posture& posture = motion->getPosture(i);
+        hash = hashValues(posture.bone_rotations.data(), posture.bone_rotations.size(), hash);
+        hash = hashValues(posture.bone_translations.data(), posture.bone_translations.size(), hash);
+        hash = hashValues(posture.bone_quaternions.data(), posture.bone_quaternions.size(), hash);
+    }
+    return hash;
+}
+
+void downsampleFeatures(const MotionFeatures& features, MotionFeatures* coarse) {
+    coarse->frame_num = (features.frame_num + 1) / 2;
+    coarse->dimension = features.dimension;
+    coarse->values.resize(static_cast<std::size_t>(coarse->frame_num) * coarse->dimension);
+    for (int i = 0; i < coarse->frame_num; ++i) {
+        const double* first = features.getFrame(2 * i);
+        const double* second = 2 * i + 1 < features.frame_num ? features.getFrame(2 * i + 1) : first;
+        double* frame = coarse->values.data() + static_cast<std::size_t>(i) * coarse->dimension;
+        for (int k = 0; k < coarse->dimension; ++k) frame[k] = 0.5 * (first[k] + second[k]);
+    }
+}
+}  // namespace kinematics
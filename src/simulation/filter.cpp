@@ -0,0 +1,189 @@
+#include "simulation/filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/helper.h"
+#include "util/simd.h"
+#include "util/thread_pool.h"
+
+namespace kinematics {
+namespace {
+// Translation x y z and quaternion x y z w of every bone
+constexpr std::size_t channels_per_bone = 7;
+// Frames moved together between frame-major and channel-major layout, so that each channel is written
+// (or read) in runs instead of one double per page
+constexpr std::size_t transpose_block = 64;
+
+// Second order low-pass Butterworth section from the bilinear transform
+struct Biquad final {
+    double b0, b1, b2, a1, a2;
+};
+
+Biquad butterworth(double cutoff, double frame_rate) {
+    // Stay below Nyquist where the prewarped frequency blows up
+    double k = std::tan(util::PI * std::min(cutoff / frame_rate, 0.49));
+    double norm = 1.0 / (1.0 + std::sqrt(2.0) * k + k * k);
+    Biquad biquad;
+    biquad.b0 = k * k * norm;
+    biquad.b1 = 2.0 * biquad.b0;
+    biquad.b2 = biquad.b0;
+    biquad.a1 = 2.0 * (k * k - 1.0) * norm;
+    biquad.a2 = (1.0 - std::sqrt(2.0) * k + k * k) * norm;
+    return biquad;
+}
+
+// Run the section over n samples spaced by stride (negative runs backward), in place.
+// The state starts at rest on the first sample so the ends do not ring
+void runBiquad(const Biquad& biquad, double* track, std::size_t n, std::ptrdiff_t stride) {
+    double x1 = track[0], x2 = track[0], y1 = track[0], y2 = track[0];
+    for (std::size_t i = 0; i < n; ++i, track += stride) {
+        double x = *track;
+        double y = biquad.b0 * x + biquad.b1 * x1 + biquad.b2 * x2 - biquad.a1 * y1 - biquad.a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        *track = y;
+    }
+}
+
+// Filter a channel in place, scratch holds the convolution output
+void filterChannel(const FilterOptions& options, const std::vector<double>& taps, const Biquad& biquad, double* track,
+                   std::size_t n, std::vector<double>* scratch) {
+    if (options.type == FilterType::Gaussian) {
+        if (taps.size() == 1) return;
+        scratch->resize(n);
+        util::simd::kernels().convolve(track, n, taps.data(), taps.size(), scratch->data());
+        std::copy(scratch->begin(), scratch->end(), track);
+    } else {
+        runBiquad(biquad, track, n, 1);
+        runBiquad(biquad, track + n - 1, n, -1);
+    }
+}
+}  // namespace
+
+std::vector<double> gaussianTaps(double sigma_frames) {
+    int radius = static_cast<int>(std::ceil(3.0 * sigma_frames));
+    if (sigma_frames <= 0.0 || radius < 1) return {1.0};
+    std::vector<double> taps(2 * radius + 1);
+    double sum = 0.0;
+    for (int k = -radius; k <= radius; ++k) {
+        taps[k + radius] = std::exp(-0.5 * k * k / (sigma_frames * sigma_frames));
+        sum += taps[k + radius];
+    }
+    for (double& tap : taps) tap /= sum;
+    return taps;
+}
+
+void filterPostures(const std::vector<acclaim::Posture>& postures, double frame_rate, const FilterOptions& options,
+                    std::vector<acclaim::Posture>* filtered) {
+    std::size_t total_frames = postures.size();
+    if (total_frames == 0 || frame_rate <= 0.0) {
+        filtered->clear();
+        return;
+    }
+    std::size_t total_bones = postures[0].bone_rotations.size();
+    std::vector<double> taps = gaussianTaps(options.sigma * frame_rate);
+    Biquad biquad = butterworth(options.cutoff, frame_rate);
+
+    // Channel-major copy, channel c of bone j starts at (j * channels_per_bone + c) * total_frames
+    util::ThreadPool& pool = util::ThreadPool::global();
+    std::vector<double> channels(total_bones * channels_per_bone * total_frames);
+    std::size_t total_blocks = (total_frames + transpose_block - 1) / transpose_block;
+    pool.parallelFor(total_blocks, 1, [&](std::size_t begin, std::size_t end) {
+        std::vector<Eigen::Quaterniond> rotations(transpose_block * total_bones, Eigen::Quaterniond::Identity());
+        for (std::size_t block = begin; block < end; ++block) {
+            std::size_t first = block * transpose_block;
+            std::size_t count = std::min(transpose_block, total_frames - first);
+            for (std::size_t i = 0; i < count; ++i) {
+                const acclaim::Posture& posture = postures[first + i];
+                if (posture.bone_quaternions.empty()) {
+                    util::rotateDegreeZYX(posture.bone_rotations.data(), &rotations[i * total_bones], total_bones);
+                } else {
+                    std::copy(posture.bone_quaternions.begin(), posture.bone_quaternions.end(),
+                              rotations.begin() + i * total_bones);
+                }
+            }
+            for (std::size_t j = 0; j < total_bones; ++j) {
+                double* bone_channels = &channels[j * channels_per_bone * total_frames + first];
+                for (int c = 0; c < 3; ++c) {
+                    double* channel = bone_channels + c * total_frames;
+                    for (std::size_t i = 0; i < count; ++i) channel[i] = postures[first + i].bone_translations[j][c];
+                }
+                for (int c = 0; c < 4; ++c) {
+                    double* channel = bone_channels + (c + 3) * total_frames;
+                    for (std::size_t i = 0; i < count; ++i) channel[i] = rotations[i * total_bones + j].coeffs()[c];
+                }
+            }
+        }
+    });
+
+    pool.parallelFor(total_bones, 1, [&](std::size_t begin, std::size_t end) {
+        std::vector<double> scratch;
+        for (std::size_t j = begin; j < end; ++j) {
+            double* bone_channels = &channels[j * channels_per_bone * total_frames];
+            if (options.filter_translations) {
+                for (int c = 0; c < 3; ++c) {
+                    filterChannel(options, taps, biquad, bone_channels + c * total_frames, total_frames, &scratch);
+                }
+            }
+            double* x = bone_channels + 3 * total_frames;
+            double* y = x + total_frames;
+            double* z = y + total_frames;
+            double* w = z + total_frames;
+            // q and -q are the same rotation, flip onto the hemisphere of the previous frame before averaging
+            for (std::size_t i = 1; i < total_frames; ++i) {
+                if (x[i] * x[i - 1] + y[i] * y[i - 1] + z[i] * z[i - 1] + w[i] * w[i - 1] < 0.0) {
+                    x[i] = -x[i];
+                    y[i] = -y[i];
+                    z[i] = -z[i];
+                    w[i] = -w[i];
+                }
+            }
+            if (options.filter_rotations) {
+                for (int c = 3; c < 7; ++c) {
+                    filterChannel(options, taps, biquad, bone_channels + c * total_frames, total_frames, &scratch);
+                }
+            }
+        }
+    });
+
+    filtered->resize(total_frames);
+    pool.parallelFor(total_blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t block = begin; block < end; ++block) {
+            std::size_t first = block * transpose_block;
+            std::size_t count = std::min(transpose_block, total_frames - first);
+            for (std::size_t i = first; i < first + count; ++i) {
+                acclaim::Posture& output = (*filtered)[i];
+                output.bone_rotations.resize(total_bones);
+                output.bone_translations.resize(total_bones);
+                output.bone_quaternions.resize(total_bones);
+            }
+            for (std::size_t j = 0; j < total_bones; ++j) {
+                const double* bone_channels = &channels[j * channels_per_bone * total_frames + first];
+                for (int c = 0; c < 3; ++c) {
+                    const double* channel = bone_channels + c * total_frames;
+                    for (std::size_t i = 0; i < count; ++i) (*filtered)[first + i].bone_translations[j][c] = channel[i];
+                }
+                for (int c = 0; c < 4; ++c) {
+                    const double* channel = bone_channels + (c + 3) * total_frames;
+                    for (std::size_t i = 0; i < count; ++i) {
+                        (*filtered)[first + i].bone_quaternions[j].coeffs()[c] = channel[i];
+                    }
+                }
+            }
+            for (std::size_t i = first; i < first + count; ++i) {
+                acclaim::Posture& output = (*filtered)[i];
+                for (std::size_t j = 0; j < total_bones; ++j) {
+                    Eigen::Quaterniond& rotation = output.bone_quaternions[j];
+                    rotation.normalize();
+                    output.bone_translations[j][3] = 0.0;
+                    output.bone_rotations[j] =
+                        options.euler_angles ? util::toDegreeZYX(rotation) : postures[i].bone_rotations[j];
+                }
+            }
+        }
+    });
+}
+}  // namespace kinematics
@@ -0,0 +1,277 @@
+#include "simulation/keyframe_compression.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Eigen/Geometry"
+
+#include "acclaim/skeleton.h"
+#include "simulation/kinematics.h"
+#include "util/helper.h"
+#include "util/thread_pool.h"
+
+namespace kinematics {
+namespace {
+// Distance from the start of every bone to the farthest end below it, bones are sorted parent before child
+std::vector<double> boneReach(acclaim::Skeleton* skeleton) {
+    int total_bones = skeleton->getBoneNum();
+    std::vector<double> below(total_bones, 0.0), reach(total_bones, 0.0);
+    for (int i = total_bones - 1; i >= 0; --i) {
+        const acclaim::Bone& bone = *skeleton->getBonePointer(i);
+        reach[i] = bone.length + below[i];
+        if (bone.parent != nullptr) below[bone.parent->idx] = std::max(below[bone.parent->idx], reach[i]);
+    }
+    return reach;
+}
+
+// End positions of every bone of every frame, frame major
+void solvePositions(acclaim::Skeleton* skeleton, const std::vector<acclaim::Posture>& postures,
+                    std::vector<Eigen::Vector3d>* positions) {
+    int total_bones = skeleton->getBoneNum();
+    positions->resize(postures.size() * total_bones);
+    for (std::size_t i = 0; i < postures.size(); ++i) {
+        forwardSolverBatch(postures[i], skeleton);
+        for (int j = 0; j < total_bones; ++j) {
+            (*positions)[i * total_bones + j] = skeleton->getBonePointer(j)->end_position.head<3>();
+        }
+    }
+}
+}  // namespace
+
+void CompressedMotion::Track::evaluate(std::size_t segment, double frame, double* out) const {
+    const std::size_t last = frames.size() - 1;
+    if (last == 0 || frame <= frames[0]) {
+        for (int k = 0; k < channels; ++k) out[k] = values[k];
+        return;
+    }
+    if (segment >= last) {
+        for (int k = 0; k < channels; ++k) out[k] = values[last * channels + k];
+        return;
+    }
+    // Catmull-Rom tangents (per frame) at both keys, one sided at the ends of the track
+    std::size_t keys[4] = {segment == 0 ? 0 : segment - 1, segment, segment + 1, std::min(segment + 2, last)};
+    double t0 = frames[segment], t1 = frames[segment + 1];
+    double span = t1 - t0;
+    double s = (frame - t0) / span;
+    double s2 = s * s, s3 = s2 * s;
+    double h00 = 2.0 * s3 - 3.0 * s2 + 1.0, h10 = s3 - 2.0 * s2 + s, h01 = -2.0 * s3 + 3.0 * s2, h11 = s3 - s2;
+    double tangent_span0 = frames[keys[2]] - frames[keys[0]];
+    double tangent_span1 = frames[keys[3]] - frames[keys[1]];
+    for (int k = 0; k < channels; ++k) {
+        double p0 = values[keys[1] * channels + k], p1 = values[keys[2] * channels + k];
+        double m0 = (values[keys[2] * channels + k] - values[keys[0] * channels + k]) / tangent_span0;
+        double m1 = (values[keys[3] * channels + k] - values[keys[1] * channels + k]) / tangent_span1;
+        out[k] = h00 * p0 + h10 * span * m0 + h01 * p1 + h11 * span * m1;
+    }
+}
+
+void CompressedMotion::Track::fit(const std::vector<double>& samples, int _channels, double tolerance) {
+    channels = _channels;
+    const int total_frames = static_cast<int>(samples.size()) / channels;
+    std::vector<std::int32_t> keys = {0};
+    bool constant = true;
+    for (std::size_t i = channels; i < samples.size() && constant; ++i) {
+        constant = std::abs(samples[i] - samples[i % channels]) <= tolerance;
+    }
+    if (!constant) keys.push_back(total_frames - 1);
+    std::vector<std::int32_t> inserted;
+    std::vector<double> value(channels);
+    while (true) {
+        frames = keys;
+        values.resize(keys.size() * channels);
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            for (int k = 0; k < channels; ++k) {
+                values[i * channels + k] = static_cast<float>(samples[keys[i] * channels + k]);
+            }
+        }
+        // Worst frame between every pair of keys, keys themselves are exact up to float rounding
+        inserted.clear();
+        for (std::size_t segment = 0; segment + 1 < keys.size(); ++segment) {
+            double worst_error = tolerance;
+            int worst = -1;
+            for (int i = keys[segment] + 1; i < keys[segment + 1]; ++i) {
+                evaluate(segment, i, value.data());
+                for (int k = 0; k < channels; ++k) {
+                    double channel_error = std::abs(value[k] - samples[i * channels + k]);
+                    if (channel_error > worst_error) {
+                        worst_error = channel_error;
+                        worst = i;
+                    }
+                }
+            }
+            if (worst >= 0) inserted.push_back(worst);
+        }
+        if (inserted.empty()) break;
+        std::vector<std::int32_t> merged(keys.size() + inserted.size());
+        std::merge(keys.begin(), keys.end(), inserted.begin(), inserted.end(), merged.begin());
+        keys.swap(merged);
+    }
+}
+
+CompressedMotion::CompressedMotion() noexcept {}
+
+CompressedMotion::CompressedMotion(acclaim::Skeleton* skeleton, const std::vector<acclaim::Posture>& postures,
+                                   double _frame_rate, const CompressionOptions& options) noexcept
+    : frame_num(static_cast<int>(postures.size())), frame_rate(_frame_rate) {
+    if (frame_num == 0) return;
+    const int total_bones = skeleton->getBoneNum();
+    quaternions = !postures[0].bone_quaternions.empty();
+    const int rotation_channels = quaternions ? 4 : 3;
+    // Tracks are made continuous first: Euler angles unwrapped, quaternions kept on one hemisphere
+    std::vector<std::vector<double>> rotation_samples(total_bones), translation_samples(total_bones);
+    for (int j = 0; j < total_bones; ++j) {
+        std::vector<double>& rotations = rotation_samples[j];
+        std::vector<double>& translations = translation_samples[j];
+        rotations.resize(static_cast<std::size_t>(frame_num) * rotation_channels);
+        translations.resize(static_cast<std::size_t>(frame_num) * 3);
+        for (int i = 0; i < frame_num; ++i) {
+            double* rotation = &rotations[static_cast<std::size_t>(i) * rotation_channels];
+            const double* previous = rotation - rotation_channels;
+            if (quaternions) {
+                Eigen::Map<Eigen::Vector4d> quaternion(rotation);
+                quaternion = postures[i].bone_quaternions[j].coeffs();
+                if (i > 0 && quaternion.dot(Eigen::Map<const Eigen::Vector4d>(previous)) < 0.0) quaternion *= -1.0;
+            } else {
+                for (int k = 0; k < 3; ++k) {
+                    rotation[k] = postures[i].bone_rotations[j][k];
+                    if (i > 0) rotation[k] -= 360.0 * std::round((rotation[k] - previous[k]) / 360.0);
+                }
+            }
+            for (int k = 0; k < 3; ++k) {
+                translations[static_cast<std::size_t>(i) * 3 + k] = postures[i].bone_translations[j][k];
+            }
+        }
+    }
+    std::vector<double> reach = boneReach(skeleton);
+    std::vector<Eigen::Vector3d> reference, positions;
+    solvePositions(skeleton, postures, &reference);
+    std::vector<acclaim::Posture> decoded;
+    rotation_tracks.resize(total_bones);
+    translation_tracks.resize(total_bones);
+    // Largest tolerance scale passing the check: halve until one passes, then bisect towards the last failure
+    double scale = 1.0, passing = 0.0, failing = -1.0, passing_error = -1.0;
+    std::vector<Track> passing_rotations, passing_translations;
+    for (int iteration = 0; iteration <= options.max_iterations; ++iteration) {
+        if (iteration == options.max_iterations) {
+            if (passing_error >= 0.0) break;
+            // Nothing passed, keep every frame that differs
+            scale = 0.0;
+        }
+        util::ThreadPool::global().parallelFor(total_bones, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t j = begin; j < end; ++j) {
+                // A rotation by angle moves the farthest end below the bone by up to angle * reach
+                double angle = scale * options.max_error / std::max(reach[j], 1e-6);
+                double rotation_tolerance = quaternions ? 0.5 * angle : angle * 180.0 / util::PI;
+                rotation_tracks[j].fit(rotation_samples[j], rotation_channels, rotation_tolerance);
+                translation_tracks[j].fit(translation_samples[j], 3, scale * options.max_error);
+            }
+        });
+        decode(&decoded);
+        solvePositions(skeleton, decoded, &positions);
+        error = 0.0;
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            error = std::max(error, (positions[i] - reference[i]).norm());
+        }
+        if (error <= options.max_error || scale == 0.0) {
+            passing = scale;
+            passing_error = error;
+            passing_rotations.swap(rotation_tracks);
+            passing_translations.swap(translation_tracks);
+            rotation_tracks.resize(total_bones);
+            translation_tracks.resize(total_bones);
+            if (failing < 0.0) break;
+        } else {
+            failing = scale;
+        }
+        scale = passing > 0.0 ? 0.5 * (passing + failing) : 0.5 * failing;
+    }
+    rotation_tracks.swap(passing_rotations);
+    translation_tracks.swap(passing_translations);
+    error = passing_error;
+}
+
+int CompressedMotion::getFrameNum() const { return frame_num; }
+
+double CompressedMotion::getFrameRate() const { return frame_rate; }
+
+std::size_t CompressedMotion::getKeyNum() const {
+    std::size_t keys = 0;
+    for (const Track& track : rotation_tracks) keys += track.frames.size();
+    for (const Track& track : translation_tracks) keys += track.frames.size();
+    return keys;
+}
+
+std::size_t CompressedMotion::getByteSize() const {
+    std::size_t bytes = 0;
+    for (const std::vector<Track>* tracks : {&rotation_tracks, &translation_tracks}) {
+        for (const Track& track : *tracks) {
+            bytes += track.frames.size() * sizeof(std::int32_t) + track.values.size() * sizeof(float);
+        }
+    }
+    return bytes;
+}
+
+double CompressedMotion::getError() const { return error; }
+
+void CompressedMotion::sample(double frame, acclaim::Posture* posture) const {
+    const int total_bones = static_cast<int>(rotation_tracks.size());
+    if (posture->bone_rotations.size() != static_cast<std::size_t>(total_bones)) {
+        *posture = acclaim::Posture(total_bones);
+    }
+    if (!quaternions) posture->bone_quaternions.clear();
+    frame = std::clamp(frame, 0.0, static_cast<double>(std::max(frame_num - 1, 0)));
+    double rotation[4], translation[3];
+    for (int j = 0; j < total_bones; ++j) {
+        for (const Track* track : {&rotation_tracks[j], &translation_tracks[j]}) {
+            auto key = std::upper_bound(track->frames.begin(), track->frames.end(), frame);
+            std::size_t segment = key == track->frames.begin() ? 0 : key - track->frames.begin() - 1;
+            track->evaluate(segment, frame, track == &rotation_tracks[j] ? rotation : translation);
+        }
+        setBone(j, rotation, translation, posture);
+    }
+}
+
+void CompressedMotion::decode(std::vector<acclaim::Posture>* postures) const {
+    const int total_bones = static_cast<int>(rotation_tracks.size());
+    postures->resize(frame_num);
+    for (acclaim::Posture& posture : *postures) {
+        if (posture.bone_rotations.size() != static_cast<std::size_t>(total_bones)) {
+            posture = acclaim::Posture(total_bones);
+        }
+        if (!quaternions) posture.bone_quaternions.clear();
+    }
+    // Track by track, the key before the frame only moves forward
+    double rotation[4], translation[3];
+    for (int j = 0; j < total_bones; ++j) {
+        std::size_t rotation_segment = 0, translation_segment = 0;
+        const Track& rotations = rotation_tracks[j];
+        const Track& translations = translation_tracks[j];
+        for (int i = 0; i < frame_num; ++i) {
+            while (rotation_segment + 1 < rotations.frames.size() && rotations.frames[rotation_segment + 1] <= i) {
+                ++rotation_segment;
+            }
+            while (translation_segment + 1 < translations.frames.size() &&
+                   translations.frames[translation_segment + 1] <= i) {
+                ++translation_segment;
+            }
+            rotations.evaluate(rotation_segment, i, rotation);
+            translations.evaluate(translation_segment, i, translation);
+            setBone(j, rotation, translation, &(*postures)[i]);
+        }
+    }
+}
+
+void CompressedMotion::setBone(int bone_idx, const double* rotation, const double* translation,
+                               acclaim::Posture* posture) const {
+    if (quaternions) {
+        if (posture->bone_quaternions.size() != posture->bone_rotations.size()) {
+            posture->bone_quaternions.resize(posture->bone_rotations.size(), Eigen::Quaterniond::Identity());
+        }
+        posture->bone_quaternions[bone_idx].coeffs() = Eigen::Map<const Eigen::Vector4d>(rotation).normalized();
+        posture->bone_rotations[bone_idx] = util::toDegreeZYX(posture->bone_quaternions[bone_idx]);
+    } else {
+        posture->bone_rotations[bone_idx] << rotation[0], rotation[1], rotation[2], 0.0;
+    }
+    posture->bone_translations[bone_idx] << translation[0], translation[1], translation[2], 0.0;
+}
+}  // namespace kinematics
@@ -1,13 +1,99 @@
 #include "simulation/kinematics.h"
 
+#include <algorithm>
+
 #include "Eigen/Dense"
 
 #include "acclaim/bone.h"
+#include "acclaim/skeleton.h"
 #include "util/helper.h"
+#include "util/simd.h"
+#include "util/thread_pool.h"
 
 #define M_PI 3.1415
 
 namespace kinematics {
+namespace {
+// Compute global transform of a single bone, its parent must be solved already
+void solveBone(const acclaim::Posture& posture, acclaim::Bone* bone) {
+    int bone_idx = bone->idx;
+    acclaim::Bone* parentBone = bone->parent;
+
+    bone->start_position = posture.bone_translations[bone_idx];
+    if (posture.bone_quaternions.empty()) {
+        bone->rotation =
+            bone->rot_parent_current * Eigen::Affine3d(util::rotateDegreeZYX(posture.bone_rotations[bone_idx]));
+    } else {
+        bone->rotation = bone->rot_parent_current * Eigen::Affine3d(posture.bone_quaternions[bone_idx]);
+    }
+
+    if (parentBone != nullptr) {
+        bone->start_position = parentBone->end_position + posture.bone_translations[bone_idx];
+        bone->rotation = parentBone->rotation * bone->rotation;
+    }
+
+    bone->end_position = bone->start_position + bone->rotation * (bone->dir * bone->length);
+}
+
+// Quaternion track of the posture, converted from Euler angles into buffer if the posture has none
+const double* quaternionTrack(const acclaim::Posture& posture, std::vector<Eigen::Quaterniond>* buffer) {
+    if (!posture.bone_quaternions.empty()) return posture.bone_quaternions[0].coeffs().data();
+    buffer->resize(posture.bone_rotations.size());
+    util::rotateDegreeZYX(posture.bone_rotations.data(), buffer->data(), buffer->size());
+    return (*buffer)[0].coeffs().data();
+}
+
+// Flattened skeleton and scratch buffers for the batched solver
+struct BatchBuffers {
+    std::vector<int> parents;
+    std::vector<double> rest_rotations, offsets, quaternions, translations, rotations, start_positions, end_positions;
+};
+
+BatchBuffers& batchBuffers() {
+    static thread_local BatchBuffers buffers;
+    return buffers;
+}
+
+// Fill the skeleton part of buffers and size the rest, false if a bone comes before its parent
+bool flattenSkeleton(acclaim::Skeleton* skeleton, BatchBuffers* buffers) {
+    const std::size_t total_bones = skeleton->getBoneNum();
+    buffers->parents.resize(total_bones);
+    buffers->rest_rotations.resize(9 * total_bones);
+    buffers->offsets.resize(4 * total_bones);
+    buffers->quaternions.resize(4 * total_bones);
+    buffers->translations.resize(4 * total_bones);
+    buffers->rotations.resize(9 * total_bones);
+    buffers->start_positions.resize(4 * total_bones);
+    buffers->end_positions.resize(4 * total_bones);
+    for (std::size_t i = 0; i < total_bones; ++i) {
+        const acclaim::Bone& bone = *skeleton->getBonePointer(static_cast<int>(i));
+        int parent = bone.parent == nullptr ? -1 : bone.parent->idx;
+        // The kernel needs parents solved before children
+        if (parent >= static_cast<int>(i)) return false;
+        buffers->parents[i] = parent;
+        Eigen::Map<Eigen::Matrix3d>(&buffers->rest_rotations[9 * i]) = bone.rot_parent_current.linear();
+        Eigen::Map<Eigen::Vector4d>(&buffers->offsets[4 * i]) = bone.dir * bone.length;
+    }
+    return true;
+}
+
+// Run the kernel on local rotations (quaternions) and translations (4 doubles per bone) and write back the bones
+void solveFlattened(const double* local_rotations, const double* translations, acclaim::Skeleton* skeleton,
+                    BatchBuffers* buffers) {
+    const std::size_t total_bones = skeleton->getBoneNum();
+    util::simd::kernels().forwardKinematics(buffers->parents.data(), buffers->rest_rotations.data(), local_rotations,
+                                            buffers->offsets.data(), translations, buffers->rotations.data(),
+                                            buffers->start_positions.data(), buffers->end_positions.data(),
+                                            total_bones);
+    for (std::size_t i = 0; i < total_bones; ++i) {
+        acclaim::Bone& bone = *skeleton->getBonePointer(static_cast<int>(i));
+        bone.rotation.linear() = Eigen::Map<const Eigen::Matrix3d>(&buffers->rotations[9 * i]);
+        bone.start_position = Eigen::Map<const Eigen::Vector4d>(&buffers->start_positions[4 * i]);
+        bone.end_position = Eigen::Map<const Eigen::Vector4d>(&buffers->end_positions[4 * i]);
+    }
+}
+}  // namespace
+
 void forwardSolver(const acclaim::Posture& posture, acclaim::Bone* bone) {
     // TODO
     // This function will be called with bone == root bone of the skeleton
@@ -19,84 +105,175 @@ void forwardSolver(const acclaim::Posture& posture, acclaim::Bone* bone) {
 
     if (bone == nullptr) { return; }
 
-    int bone_idx = bone->idx;
-    acclaim::Bone* parentBone = bone->parent;
+    solveBone(posture, bone);
 
-    bone->start_position = posture.bone_translations[bone_idx];
-    bone->rotation =
-        bone->rot_parent_current * Eigen::Affine3d(util::rotateDegreeZYX(posture.bone_rotations[bone_idx]));
+    forwardSolver(posture, bone->sibling);
+    forwardSolver(posture, bone->child);
 
-    if (parentBone != nullptr) {
-        bone->start_position = parentBone->end_position + posture.bone_translations[bone_idx];
-        bone->rotation = parentBone->rotation * bone->rotation;
+    return;
+}
+
+void forwardSolverReduced(const acclaim::Posture& posture, acclaim::Bone* bone) {
+    if (bone == nullptr) { return; }
+
+    if (bone->collapsed) {
+        // Collapsed bones keep their rest orientation relative to the parent
+        acclaim::Bone* parentBone = bone->parent;
+        bone->start_position = parentBone->end_position;
+        bone->rotation = parentBone->rotation * bone->rot_parent_current;
+        bone->end_position = bone->start_position + bone->rotation * (bone->dir * bone->length);
+    } else {
+        solveBone(posture, bone);
     }
 
-    bone->end_position = bone->start_position + bone->rotation * (bone->dir * bone->length);
+    forwardSolverReduced(posture, bone->sibling);
+    forwardSolverReduced(posture, bone->child);
+}
 
-    forwardSolver(posture, bone->sibling);
-    forwardSolver(posture, bone->child);
+void forwardSolverBatch(const acclaim::Posture& posture, acclaim::Skeleton* skeleton) {
+    BatchBuffers& buffers = batchBuffers();
+    const std::size_t total_bones = skeleton->getBoneNum();
+    if (!flattenSkeleton(skeleton, &buffers)) {
+        forwardSolver(posture, skeleton->getBonePointer(acclaim::Skeleton::root_idx()));
+        return;
+    }
+    const double* local_rotations = buffers.quaternions.data();
+    if (posture.bone_quaternions.empty()) {
+        util::simd::kernels().eulerToQuaternionZYX(posture.bone_rotations[0].data(), util::PI / 180.0,
+                                                   buffers.quaternions.data(), total_bones);
+    } else {
+        local_rotations = posture.bone_quaternions[0].coeffs().data();
+    }
+    solveFlattened(local_rotations, posture.bone_translations[0].data(), skeleton, &buffers);
+}
 
-    return;
+void forwardSolverQuantized(const QuantizedPostures& postures, int frame_idx, acclaim::Skeleton* skeleton) {
+    BatchBuffers& buffers = batchBuffers();
+    if (!flattenSkeleton(skeleton, &buffers)) {
+        static thread_local acclaim::Posture posture;
+        postures.getPosture(frame_idx, &posture);
+        forwardSolver(posture, skeleton->getBonePointer(acclaim::Skeleton::root_idx()));
+        return;
+    }
+    postures.dequantize(frame_idx, buffers.quaternions.data(), buffers.translations.data());
+    solveFlattened(buffers.quaternions.data(), buffers.translations.data(), skeleton, &buffers);
 }
 
-std::vector<acclaim::Posture> timeWarper(const std::vector<acclaim::Posture>& postures, int keyframe_old,
-                                         int keyframe_new) {
+TimeMap makeTimeWarp(int keyframe_old, int keyframe_new) {
+    PiecewiseTimeMap time_map;
+    time_map.addKey(0, 0);
+    time_map.addKey(keyframe_new, keyframe_old);
+    return time_map;
+}
+
+void warpPosture(const std::vector<acclaim::Posture>& postures, double source_frame, acclaim::Posture* posture) {
     int total_frames = static_cast<int>(postures.size());
-    int total_bones = static_cast<int>(postures[0].bone_rotations.size());
+    source_frame = std::clamp(source_frame, 0.0, double(total_frames - 1));
+    int lowerBound = static_cast<int>(source_frame);
+    int upperBound = std::min(lowerBound + 1, total_frames - 1);
+    double ratioBetweenBoundary = source_frame - double(lowerBound);
+
+    const acclaim::Posture& from = postures[lowerBound];
+    const acclaim::Posture& to = postures[upperBound];
+    if (ratioBetweenBoundary == 0) {
+        *posture = from;
+        return;
+    }
+    // Euler angles next to a quaternion track may be stale (see acclaim::Posture), blend the track instead
+    if (!from.bone_quaternions.empty() || !to.bone_quaternions.empty()) {
+        interpolatePosture(from, to, ratioBetweenBoundary, posture);
+        return;
+    }
+    std::size_t total_bones = from.bone_rotations.size();
+    if (posture->bone_rotations.size() != total_bones) *posture = acclaim::Posture(total_bones);
+    posture->bone_quaternions.clear();
+    // from, to and interpolated rotations
+    static thread_local std::vector<Eigen::Quaterniond> rotations;
+    rotations.resize(3 * total_bones);
+    double* from_rotations = rotations[0].coeffs().data();
+    double* to_rotations = rotations[total_bones].coeffs().data();
+    double* rotations_between = rotations[2 * total_bones].coeffs().data();
+    const util::simd::Kernels& kernels = util::simd::kernels();
+    kernels.eulerToQuaternionXYZ(from.bone_rotations[0].data(), M_PI / 180, from_rotations, total_bones);
+    kernels.eulerToQuaternionXYZ(to.bone_rotations[0].data(), M_PI / 180, to_rotations, total_bones);
+    kernels.slerp(from_rotations, to_rotations, ratioBetweenBoundary, rotations_between, total_bones);
 
-    double ratio = double(keyframe_old) / double(keyframe_new);
-    int difference = keyframe_new - keyframe_old;
+    for (std::size_t j = 0; j < total_bones; ++j) {
+        Eigen::Vector4d translationDifference = to.bone_translations[j] - from.bone_translations[j];
+        posture->bone_translations[j] = from.bone_translations[j] + translationDifference * ratioBetweenBoundary;
 
-    std::vector<acclaim::Posture> new_postures = postures;
-    for (int i = 0; i < total_frames; ++i) {
+        Eigen::Vector3d eulerAngles =
+            rotations[2 * total_bones + j].normalized().toRotationMatrix().eulerAngles(0, 1, 2);
+        posture->bone_rotations[j] = Eigen::Vector4d(eulerAngles[0] * 180 / M_PI, eulerAngles[1] * 180 / M_PI,
+                                                     eulerAngles[2] * 180 / M_PI, 0);
+    }
+}
 
-        int newKeyframe = i;
-        double oldKeyframeNum = ratio * i;
-        if (i > keyframe_new) {
-            oldKeyframeNum = i - difference;
-        }
+void interpolatePosture(const acclaim::Posture& from, const acclaim::Posture& to, double t,
+                        acclaim::Posture* posture, bool euler_angles) {
+    std::size_t total_bones = from.bone_rotations.size();
+    posture->bone_translations.resize(total_bones);
+    posture->bone_quaternions.resize(total_bones);
+    static thread_local std::vector<Eigen::Quaterniond> from_buffer, to_buffer;
+    util::simd::kernels().nlerp(quaternionTrack(from, &from_buffer), quaternionTrack(to, &to_buffer), t,
+                                posture->bone_quaternions[0].coeffs().data(), total_bones);
+    for (std::size_t j = 0; j < total_bones; ++j) {
+        posture->bone_translations[j] =
+            from.bone_translations[j] + (to.bone_translations[j] - from.bone_translations[j]) * t;
+    }
+    if (!euler_angles) {
+        posture->bone_rotations = from.bone_rotations;
+        return;
+    }
+    posture->bone_rotations.resize(total_bones);
+    for (std::size_t j = 0; j < total_bones; ++j) {
+        posture->bone_rotations[j] = util::toDegreeZYX(posture->bone_quaternions[j]);
+    }
+}
+
+void warpPostureQuaternion(const std::vector<acclaim::Posture>& postures, double source_frame,
+                           acclaim::Posture* posture) {
+    int total_frames = static_cast<int>(postures.size());
+    source_frame = std::clamp(source_frame, 0.0, double(total_frames - 1));
+    int lowerBound = static_cast<int>(source_frame);
+    int upperBound = std::min(lowerBound + 1, total_frames - 1);
+    double ratioBetweenBoundary = source_frame - double(lowerBound);
+
+    interpolatePosture(postures[lowerBound], postures[upperBound], ratioBetweenBoundary, posture);
+}
 
-        if (oldKeyframeNum >= total_frames) {
-            break;
+void warpPostures(const std::vector<acclaim::Posture>& postures, const TimeMap& time_map,
+                  std::vector<acclaim::Posture>* warped) {
+    warped->resize(postures.size());
+    util::ThreadPool::global().parallelFor(postures.size(), 16, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            warpPostureQuaternion(postures, time_map(static_cast<int>(i)), &(*warped)[i]);
         }
+    });
+}
 
-        int lowerBound = oldKeyframeNum;
-        int upperBound = lowerBound + 1;
-        double ratioBetweenBoundary = oldKeyframeNum - double(lowerBound);
-
-        for (int j = 0; j < total_bones; ++j) {
-            // TODO
-            // You should set these variables:
-            //     new_postures[i].bone_translations[j] = postures[i].bone_translations[j];
-            //     new_postures[i].bone_rotations[j] = postures[i].bone_rotations[j];
-            // The sample above just change nothing
-
-            if (ratioBetweenBoundary == 0) {
-                new_postures[i].bone_translations[j] = postures[oldKeyframeNum].bone_translations[j];
-                new_postures[i].bone_rotations[j] = postures[oldKeyframeNum].bone_rotations[j];
-                continue;
-            }
-
-            Eigen::Vector4d translationDifference =
-                postures[upperBound].bone_translations[j] - postures[lowerBound].bone_translations[j];
-            new_postures[i].bone_translations[j] =
-                postures[lowerBound].bone_translations[j] + translationDifference * ratioBetweenBoundary;
-
-            Eigen::Quaterniond q1;
-            q1 = Eigen::AngleAxisd(postures[lowerBound].bone_rotations[j][0] * M_PI / 180, Eigen::Vector3d::UnitX()) *
-                 Eigen::AngleAxisd(postures[lowerBound].bone_rotations[j][1] * M_PI / 180, Eigen::Vector3d::UnitY()) *
-                 Eigen::AngleAxisd(postures[lowerBound].bone_rotations[j][2] * M_PI / 180, Eigen::Vector3d::UnitZ());
-
-            Eigen::Quaterniond q2;
-            q2 = Eigen::AngleAxisd(postures[upperBound].bone_rotations[j][0] * M_PI / 180, Eigen::Vector3d::UnitX()) *
-                 Eigen::AngleAxisd(postures[upperBound].bone_rotations[j][1] * M_PI / 180, Eigen::Vector3d::UnitY()) *
-                 Eigen::AngleAxisd(postures[upperBound].bone_rotations[j][2] * M_PI / 180, Eigen::Vector3d::UnitZ());
-
-            Eigen::Vector3d eulerAngles = q1.slerp(ratioBetweenBoundary, q2).normalized().toRotationMatrix().eulerAngles(0, 1, 2);
-            new_postures[i].bone_rotations[j] = Eigen::Vector4d(
-                eulerAngles[0] * 180 / M_PI, eulerAngles[1] * 180 / M_PI, eulerAngles[2] * 180 / M_PI, 0);
+void warpPostures(const std::vector<acclaim::Posture>& postures, const PiecewiseTimeMap& time_map,
+                  std::vector<acclaim::Posture>* warped) {
+    // Read by the pool's workers, so it cannot be thread_local
+    std::vector<double> frames(postures.size());
+    for (std::size_t i = 0; i < frames.size(); ++i) frames[i] = static_cast<double>(i);
+    time_map.evaluateSorted(frames.data(), frames.data(), frames.size());
+    warped->resize(postures.size());
+    util::ThreadPool::global().parallelFor(postures.size(), 16, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) warpPostureQuaternion(postures, frames[i], &(*warped)[i]);
+    });
+}
+
+std::vector<acclaim::Posture> timeWarper(const std::vector<acclaim::Posture>& postures, int keyframe_old,
+                                         int keyframe_new) {
+    TimeMap time_map = makeTimeWarp(keyframe_old, keyframe_new);
+    std::vector<acclaim::Posture> new_postures(postures.size());
+    // Every output frame only reads two source frames
+    util::ThreadPool::global().parallelFor(postures.size(), 16, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            warpPosture(postures, time_map(static_cast<int>(i)), &new_postures[i]);
         }
-    }
+    });
     return new_postures;
 }
 }  // namespace kinematics
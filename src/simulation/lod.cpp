@@ -0,0 +1,35 @@
+#include "simulation/lod.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "acclaim/skeleton.h"
+
+namespace kinematics {
+LODSelection LODPolicy::select(double screen_size) const {
+    LODSelection selection;
+    if (screen_size < reduced_skeleton_below) selection.level = 1;
+    if (screen_size < quarter_rate_below) {
+        selection.update_interval = 4;
+    } else if (screen_size < half_rate_below) {
+        selection.update_interval = 2;
+    }
+    return selection;
+}
+
+double screenSpaceSize(acclaim::Skeleton* skeleton, const Eigen::Matrix4f& view, const Eigen::Matrix4f& projection,
+                       int viewport_height) {
+    // Bounding sphere centered at the root, radius is the farthest bone end
+    Eigen::Vector4d center = skeleton->getBonePointer(acclaim::Skeleton::root_idx())->start_position;
+    double radius = 0.0;
+    for (int i = 0; i < skeleton->getBoneNum(); ++i) {
+        radius = std::max(radius, (skeleton->getBonePointer(i)->end_position - center).head<3>().norm());
+    }
+    Eigen::Vector4f view_center = view * Eigen::Vector4f(static_cast<float>(center[0]), static_cast<float>(center[1]),
+                                                         static_cast<float>(center[2]), 1.0f);
+    // Distance along the view direction, camera looks at -Z
+    double depth = std::max(-static_cast<double>(view_center[2]), 1e-6);
+    // projection(1, 1) = 1 / tan(fovy / 2)
+    return 2.0 * radius * projection(1, 1) / depth * 0.5 * viewport_height;
+}
+}  // namespace kinematics
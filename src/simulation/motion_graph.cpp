@@ -0,0 +1,176 @@
+#include "simulation/motion_graph.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "acclaim/motion.h"
+#include "util/binary_io.h"
+#include "util/simd.h"
+#include "util/thread_pool.h"
+
+namespace kinematics {
+namespace {
+constexpr char file_magic[4] = {'F', 'K', 'M', 'G'};
+constexpr std::uint32_t file_version = 1;
+}  // namespace
+
+MotionGraphBuilder::MotionGraphBuilder(const MotionGraphOptions& _options) noexcept : options(_options) {
+    features.dimension = 6 * static_cast<int>(options.bones.size());
+}
+
+int MotionGraphBuilder::addMotion(const std::string& name, acclaim::Motion* motion) {
+    std::vector<int> bones;
+    if (!findBones(motion->getSkeleton().get(), options.bones, name, &bones)) return -1;
+    MotionFeatures clip_features;
+    extractPoseFeatures(motion, bones, &clip_features);
+    features.values.insert(features.values.end(), clip_features.values.begin(), clip_features.values.end());
+    features.frame_num += clip_features.frame_num;
+    frame_clips.insert(frame_clips.end(), clip_features.frame_num, getClipNum());
+    clip_names.push_back(name);
+    clip_offsets.push_back(features.frame_num);
+    return getClipNum() - 1;
+}
+
+int MotionGraphBuilder::getClipNum() const { return static_cast<int>(clip_names.size()); }
+
+int MotionGraphBuilder::getFrameNum() const { return features.frame_num; }
+
+std::int64_t MotionGraphBuilder::findTransitions(const util::fs::path& file_name) {
+    std::ofstream output(file_name, std::ios::binary);
+    if (!output) {
+        std::cerr << "Failed to open " << file_name << std::endl;
+        return -1;
+    }
+    util::writeHeader(output, file_magic, file_version);
+    util::writeValue(output, static_cast<std::uint64_t>(clip_names.size()));
+    for (const std::string& name : clip_names) util::writeString(output, name);
+    // Number of transitions, filled in at the end
+    std::streampos count_position = output.tellp();
+    std::uint64_t count = 0;
+    util::writeValue(output, count);
+
+    std::vector<double> means, scales;
+    poseFeatureScales(features, options.position_weight, options.velocity_weight, &means, &scales);
+    MotionFeatures normalized = features;
+    for (int i = 0; i < normalized.frame_num; ++i) {
+        double* frame = normalized.values.data() + static_cast<std::size_t>(i) * normalized.dimension;
+        for (int k = 0; k < normalized.dimension; ++k) frame[k] = (frame[k] - means[k]) * scales[k];
+    }
+
+    // The matrix is symmetric, a row of tiles covers the tiles on and right of the diagonal. Rows are written in
+    // order so the output does not depend on the thread count
+    int total_frames = getFrameNum();
+    int tile_size = std::max(options.tile_size, 1);
+    int total_tiles = (total_frames + tile_size - 1) / tile_size;
+    std::vector<std::vector<Transition>> tile_transitions(total_tiles);
+    for (int row = 0; row < total_tiles; ++row) {
+        int row_begin = row * tile_size, row_end = std::min(row_begin + tile_size, total_frames);
+        util::ThreadPool::global().parallelFor(total_tiles - row, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                int column = row + static_cast<int>(i);
+                int column_begin = column * tile_size, column_end = std::min(column_begin + tile_size, total_frames);
+                tile_transitions[column].clear();
+                findTileTransitions(normalized, row_begin, row_end, column_begin, column_end,
+                                    &tile_transitions[column]);
+            }
+        });
+        for (int column = row; column < total_tiles; ++column) {
+            const std::vector<Transition>& transitions = tile_transitions[column];
+            util::writeArray(output, transitions.data(), transitions.size());
+            count += transitions.size();
+        }
+    }
+
+    output.seekp(count_position);
+    util::writeValue(output, count);
+    if (!output) {
+        std::cerr << "Failed to write " << file_name << std::endl;
+        return -1;
+    }
+    return static_cast<std::int64_t>(count);
+}
+
+void MotionGraphBuilder::findTileTransitions(const MotionFeatures& normalized, int row_begin, int row_end,
+                                             int column_begin, int column_end,
+                                             std::vector<Transition>* transitions) const {
+    // Only pairs with row < column, the rest is the mirror image
+    if (row_begin >= column_end - 1) return;
+    // One more frame around the tile for the local minimum test
+    int total_frames = getFrameNum();
+    int first_row = std::max(row_begin - 1, 0), last_row = std::min(row_end + 1, total_frames);
+    int first_column = std::max(column_begin - 1, 0), last_column = std::min(column_end + 1, total_frames);
+    int width = last_column - first_column;
+    int dimension = normalized.dimension;
+    // Columns dimension after dimension, so that the kernel runs across frames instead of along short vectors
+    static thread_local std::vector<double> columns, distances;
+    columns.resize(static_cast<std::size_t>(dimension) * width);
+    for (int j = 0; j < width; ++j) {
+        const double* frame = normalized.getFrame(first_column + j);
+        for (int k = 0; k < dimension; ++k) columns[static_cast<std::size_t>(k) * width + j] = frame[k];
+    }
+    distances.resize(static_cast<std::size_t>(last_row - first_row) * width);
+    const util::simd::Kernels& kernels = util::simd::kernels();
+    for (int i = first_row; i < last_row; ++i) {
+        kernels.squaredDistancesColumns(normalized.getFrame(i), columns.data(), dimension, width,
+                                        &distances[static_cast<std::size_t>(i - first_row) * width], width);
+    }
+    auto distance = [&](int i, int j) {
+        return distances[static_cast<std::size_t>(i - first_row) * width + (j - first_column)];
+    };
+
+    for (int i = row_begin; i < row_end; ++i) {
+        int from_clip = frame_clips[i];
+        for (int j = std::max(column_begin, i + 1); j < column_end; ++j) {
+            double center = distance(i, j);
+            if (center > options.threshold) continue;
+            int to_clip = frame_clips[j];
+            if (from_clip == to_clip && j - i < options.min_separation) continue;
+            // Local minimum among the neighbours in the same pair of clips. Ties go to the first one in scan order
+            bool minimum = true;
+            for (int di = -1; di <= 1 && minimum; ++di) {
+                int ni = i + di;
+                if (ni < 0 || ni >= total_frames || frame_clips[ni] != from_clip) continue;
+                for (int dj = -1; dj <= 1; ++dj) {
+                    int nj = j + dj;
+                    if ((di == 0 && dj == 0) || nj < 0 || nj >= total_frames || frame_clips[nj] != to_clip) continue;
+                    double neighbour = distance(ni, nj);
+                    bool before = di < 0 || (di == 0 && dj < 0);
+                    if (before ? neighbour <= center : neighbour < center) {
+                        minimum = false;
+                        break;
+                    }
+                }
+            }
+            if (!minimum) continue;
+            transitions->push_back(
+                {from_clip, i - clip_offsets[from_clip], to_clip, j - clip_offsets[to_clip], center});
+        }
+    }
+}
+
+bool readTransitions(const util::fs::path& file_name, std::vector<std::string>* clip_names,
+                     std::vector<Transition>* transitions) {
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input) {
+        std::cerr << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    std::uint64_t file_size = util::fs::file_size(file_name);
+    std::uint64_t clip_num = 0;
+    if (!util::readHeader(input, file_magic, file_version) || !util::readValue(input, &clip_num) ||
+        clip_num > file_size) {
+        std::cerr << file_name << " is not a transition file" << std::endl;
+        return false;
+    }
+    clip_names->resize(clip_num);
+    for (std::string& name : *clip_names) {
+        if (!util::readString(input, file_size, &name)) return false;
+    }
+    if (!util::readVector(input, file_size, transitions)) {
+        std::cerr << file_name << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+}  // namespace kinematics
@@ -0,0 +1,336 @@
+#include "simulation/motion_matching.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "Eigen/Core"
+#include "Eigen/Eigenvalues"
+
+#include "acclaim/motion.h"
+#include "simulation/features.h"
+#include "util/binary_io.h"
+#include "util/simd.h"
+
+namespace kinematics {
+namespace {
+using RowMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+constexpr char file_magic[4] = {'F', 'K', 'P', 'D'};
+constexpr std::uint32_t file_version = 2;
+}  // namespace
+
+PoseDatabase::PoseDatabase(const PoseDatabaseOptions& _options) noexcept
+    : options(_options), dimension(6 * static_cast<int>(_options.bones.size())) {
+    raw_features.dimension = dimension;
+    features.dimension = dimension;
+}
+
+int PoseDatabase::addMotion(const std::string& name, acclaim::Motion* motion) {
+    std::vector<int> bones;
+    if (!findBones(motion->getSkeleton().get(), options.bones, name, &bones)) return -1;
+    MotionFeatures pose_features;
+    extractPoseFeatures(motion, bones, &pose_features);
+    raw_features.values.insert(raw_features.values.end(), pose_features.values.begin(), pose_features.values.end());
+    clip_names.push_back(name);
+    clip_fingerprints.push_back(motionFingerprint(motion));
+    clip_offsets.push_back(clip_offsets.back() + pose_features.frame_num);
+    raw_features.frame_num = getFrameNum();
+    // The tree does not cover the new clip, queries wait for build()
+    features.values.clear();
+    features.frame_num = 0;
+    tree_frames.clear();
+    frame_positions.clear();
+    nodes.clear();
+    bounds.clear();
+    return getClipNum() - 1;
+}
+
+void PoseDatabase::build() {
+    int total_frames = getFrameNum();
+    poseFeatureScales(raw_features, options.position_weight, options.velocity_weight, &means, &scales);
+    axes.clear();
+    normalizeFeatures();
+    tree_frames.resize(total_frames);
+    for (int i = 0; i < total_frames; ++i) tree_frames[i] = i;
+    nodes.clear();
+    bounds.clear();
+    if (total_frames > 0) buildNode(0, total_frames);
+    orderFeatures();
+}
+
+int PoseDatabase::getClipNum() const { return static_cast<int>(clip_names.size()); }
+
+const std::string& PoseDatabase::getClipName(int clip_idx) const { return clip_names[clip_idx]; }
+
+int PoseDatabase::getFrameNum() const { return clip_offsets.back(); }
+
+int PoseDatabase::getDimension() const { return dimension; }
+
+const double* PoseDatabase::getFeature(int clip_idx, int frame_idx) const {
+    if (frame_positions.empty()) return nullptr;
+    return features.getFrame(frame_positions[clip_offsets[clip_idx] + frame_idx]);
+}
+
+void PoseDatabase::normalize(const double* feature, double* normalized) const {
+    Eigen::VectorXd scaled(dimension);
+    for (int k = 0; k < dimension; ++k) scaled[k] = (feature[k] - means[k]) * scales[k];
+    Eigen::Map<Eigen::VectorXd>(normalized, dimension) =
+        Eigen::Map<const RowMatrix>(axes.data(), dimension, dimension) * scaled;
+}
+
+PoseMatch PoseDatabase::query(const double* feature, double approximation) const {
+    PoseMatch best;
+    if (nodes.empty()) return best;
+    static thread_local std::vector<double> distances;
+    searchNode(0, feature, (1.0 + approximation) * (1.0 + approximation), &best, &distances);
+    // No distance compares below infinity if the feature has NaNs
+    if (best.frame < 0) return PoseMatch();
+    // Global frame to clip and frame
+    int global_frame = tree_frames[best.frame];
+    best.clip = static_cast<int>(std::upper_bound(clip_offsets.begin(), clip_offsets.end(), global_frame) -
+                                 clip_offsets.begin()) -
+                1;
+    best.frame = global_frame - clip_offsets[best.clip];
+    return best;
+}
+
+bool PoseDatabase::save(const util::fs::path& file_name) const {
+    std::ofstream output(file_name, std::ios::binary);
+    if (!output) {
+        std::cerr << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    util::writeHeader(output, file_magic, file_version);
+    util::writeValue(output, static_cast<std::uint64_t>(options.bones.size()));
+    for (const std::string& bone : options.bones) util::writeString(output, bone);
+    util::writeValue(output, options.position_weight);
+    util::writeValue(output, options.velocity_weight);
+    util::writeValue(output, options.leaf_size);
+    util::writeValue(output, static_cast<std::uint64_t>(clip_names.size()));
+    for (const std::string& name : clip_names) util::writeString(output, name);
+    util::writeVector(output, clip_fingerprints);
+    util::writeVector(output, clip_offsets);
+    util::writeVector(output, means);
+    util::writeVector(output, scales);
+    util::writeVector(output, axes);
+    util::writeVector(output, raw_features.values);
+    util::writeVector(output, tree_frames);
+    util::writeVector(output, nodes);
+    util::writeVector(output, bounds);
+    return static_cast<bool>(output);
+}
+
+bool PoseDatabase::load(const util::fs::path& file_name, const std::vector<acclaim::Motion*>& clips) {
+    std::ifstream input(file_name, std::ios::binary);
+    if (!input) return false;
+    std::uint64_t file_size = util::fs::file_size(file_name);
+    if (!util::readHeader(input, file_magic, file_version)) {
+        std::cerr << file_name << " is not a pose database" << std::endl;
+        return false;
+    }
+    // Options must match, otherwise the features mean something else
+    PoseDatabaseOptions saved;
+    std::uint64_t count;
+    if (!util::readValue(input, &count) || count > file_size) return false;
+    saved.bones.resize(count);
+    for (std::string& bone : saved.bones) {
+        if (!util::readString(input, file_size, &bone)) return false;
+    }
+    if (!util::readValue(input, &saved.position_weight) || !util::readValue(input, &saved.velocity_weight) ||
+        !util::readValue(input, &saved.leaf_size)) {
+        return false;
+    }
+    if (saved.bones != options.bones || saved.position_weight != options.position_weight ||
+        saved.velocity_weight != options.velocity_weight || saved.leaf_size != options.leaf_size) {
+        return false;
+    }
+    PoseDatabase loaded(options);
+    if (!util::readValue(input, &count) || count > file_size) return false;
+    loaded.clip_names.resize(count);
+    for (std::string& name : loaded.clip_names) {
+        if (!util::readString(input, file_size, &name)) return false;
+    }
+    if (!util::readVector(input, file_size, &loaded.clip_fingerprints) ||
+        !util::readVector(input, file_size, &loaded.clip_offsets) ||
+        !util::readVector(input, file_size, &loaded.means) || !util::readVector(input, file_size, &loaded.scales) ||
+        !util::readVector(input, file_size, &loaded.axes) ||
+        !util::readVector(input, file_size, &loaded.raw_features.values) ||
+        !util::readVector(input, file_size, &loaded.tree_frames) ||
+        !util::readVector(input, file_size, &loaded.nodes) || !util::readVector(input, file_size, &loaded.bounds)) {
+        std::cerr << file_name << " is truncated" << std::endl;
+        return false;
+    }
+    // Consistency of the sizes, then of every index query() and getFeature() follow
+    std::size_t total_frames = loaded.tree_frames.size();
+    if (loaded.clip_fingerprints.size() != loaded.clip_names.size() ||
+        loaded.clip_offsets.size() != loaded.clip_names.size() + 1 ||
+        static_cast<std::size_t>(loaded.clip_offsets.back()) != total_frames ||
+        loaded.raw_features.values.size() != total_frames * dimension ||
+        loaded.means.size() != std::size_t(dimension) || loaded.scales.size() != std::size_t(dimension) ||
+        loaded.axes.size() != std::size_t(dimension * dimension) ||
+        loaded.bounds.size() != loaded.nodes.size() * 2 * dimension || !loaded.isIndexValid()) {
+        std::cerr << file_name << " is broken" << std::endl;
+        return false;
+    }
+    // A clip edited or replaced since the file was saved has other features
+    if (clips.size() != loaded.clip_names.size()) return false;
+    for (std::size_t c = 0; c < clips.size(); ++c) {
+        if (clips[c]->getFrameNum() != loaded.clip_offsets[c + 1] - loaded.clip_offsets[c] ||
+            motionFingerprint(clips[c]) != loaded.clip_fingerprints[c]) {
+            std::cerr << file_name << " is out of date, " << loaded.clip_names[c] << " has changed" << std::endl;
+            return false;
+        }
+    }
+    loaded.raw_features.frame_num = static_cast<int>(total_frames);
+    // Same arithmetic as build(), the saved bounds enclose the features exactly
+    loaded.normalizeFeatures();
+    loaded.orderFeatures();
+    *this = std::move(loaded);
+    return true;
+}
+
+void PoseDatabase::normalizeFeatures() {
+    int total_frames = getFrameNum();
+    features.values = raw_features.values;
+    features.frame_num = total_frames;
+    Eigen::Map<RowMatrix> frames(features.values.data(), total_frames, dimension);
+    Eigen::Map<const Eigen::RowVectorXd> mean_row(means.data(), dimension), scale_row(scales.data(), dimension);
+    frames = ((frames.rowwise() - mean_row).array().rowwise() * scale_row.array()).matrix();
+    // Rotate onto the principal axes (largest variance first). Distances do not change, but the features are
+    // strongly correlated and the tree prunes much better when it splits along the axes of real variation
+    if (axes.empty()) {
+        Eigen::MatrixXd covariance = frames.transpose() * frames / std::max(total_frames, 1);
+        Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(covariance);
+        axes.resize(static_cast<std::size_t>(dimension) * dimension);
+        Eigen::Map<RowMatrix> axes_rows(axes.data(), dimension, dimension);
+        for (int r = 0; r < dimension; ++r) {
+            axes_rows.row(r) = solver.eigenvectors().col(dimension - 1 - r).transpose();
+        }
+    }
+    frames = frames * Eigen::Map<const RowMatrix>(axes.data(), dimension, dimension).transpose();
+}
+
+void PoseDatabase::orderFeatures() {
+    // Store features in tree order so that every leaf is one contiguous block
+    int total_frames = getFrameNum();
+    std::vector<double> ordered(features.values.size());
+    frame_positions.resize(total_frames);
+    for (int i = 0; i < total_frames; ++i) {
+        std::copy_n(&features.values[tree_frames[i] * dimension], dimension, &ordered[i * dimension]);
+        frame_positions[tree_frames[i]] = i;
+    }
+    features.values = std::move(ordered);
+}
+
+int PoseDatabase::buildNode(int begin, int end) {
+    int node_idx = static_cast<int>(nodes.size());
+    nodes.push_back({begin, end, -1, -1, -1});
+    bounds.resize(bounds.size() + 2 * dimension);
+    double* lower = &bounds[static_cast<std::size_t>(node_idx) * 2 * dimension];
+    double* upper = lower + dimension;
+    // Bounding box, the tree splits its widest dimension at the median
+    int split_dimension = 0;
+    double widest = -1.0;
+    for (int k = 0; k < dimension; ++k) {
+        double low = features.values[tree_frames[begin] * dimension + k], high = low;
+        for (int i = begin + 1; i < end; ++i) {
+            double value = features.values[tree_frames[i] * dimension + k];
+            low = std::min(low, value);
+            high = std::max(high, value);
+        }
+        lower[k] = low;
+        upper[k] = high;
+        if (high - low > widest) {
+            widest = high - low;
+            split_dimension = k;
+        }
+    }
+    // Leaves, or every remaining frame is identical
+    if (end - begin <= options.leaf_size || widest <= 0.0) return node_idx;
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(tree_frames.begin() + begin, tree_frames.begin() + middle, tree_frames.begin() + end,
+                     [&](int a, int b) {
+                         return features.getFrame(a)[split_dimension] < features.getFrame(b)[split_dimension];
+                     });
+    int left = buildNode(begin, middle);
+    int right = buildNode(middle, end);
+    Node& node = nodes[node_idx];
+    node.dimension = split_dimension;
+    node.left = left;
+    node.right = right;
+    return node_idx;
+}
+
+bool PoseDatabase::isIndexValid() const {
+    const int total_frames = static_cast<int>(tree_frames.size());
+    if (clip_offsets.front() != 0) return false;
+    for (std::size_t i = 1; i < clip_offsets.size(); ++i) {
+        if (clip_offsets[i] < clip_offsets[i - 1]) return false;
+    }
+    std::vector<bool> seen(total_frames, false);
+    for (int frame : tree_frames) {
+        if (frame < 0 || frame >= total_frames || seen[frame]) return false;
+        seen[frame] = true;
+    }
+    // build() makes a root over every frame (if there is any) and stores nodes depth first, so children come
+    // after their parent. That also rules out cycles for searchNode()
+    if (nodes.empty() != (total_frames == 0)) return false;
+    if (nodes.empty()) return true;
+    if (nodes[0].begin != 0 || nodes[0].end != total_frames) return false;
+    const int total_nodes = static_cast<int>(nodes.size());
+    for (int i = 0; i < total_nodes; ++i) {
+        const Node& node = nodes[i];
+        if (node.begin < 0 || node.begin >= node.end || node.end > total_frames || node.dimension >= dimension) {
+            return false;
+        }
+        if (node.dimension < 0) continue;
+        if (node.left <= i || node.left >= total_nodes || node.right <= i || node.right >= total_nodes) return false;
+        for (int child : {node.left, node.right}) {
+            if (nodes[child].begin < node.begin || nodes[child].end > node.end) return false;
+        }
+    }
+    return true;
+}
+
+double PoseDatabase::boxDistance(int node_idx, const double* feature) const {
+    const double* lower = &bounds[static_cast<std::size_t>(node_idx) * 2 * dimension];
+    const double* upper = lower + dimension;
+    double distance = 0.0;
+    for (int k = 0; k < dimension; ++k) {
+        double outside = std::max(lower[k] - feature[k], 0.0) + std::max(feature[k] - upper[k], 0.0);
+        distance += outside * outside;
+    }
+    return distance;
+}
+
+void PoseDatabase::searchNode(int node_idx, const double* feature, double scale, PoseMatch* best,
+                              std::vector<double>* distances) const {
+    const Node& node = nodes[node_idx];
+    if (node.dimension < 0) {
+        int count = node.end - node.begin;
+        distances->resize(count);
+        util::simd::kernels().squaredDistances(feature, features.getFrame(node.begin), dimension, distances->data(),
+                                               count);
+        for (int i = 0; i < count; ++i) {
+            if ((*distances)[i] < best->distance) {
+                best->distance = (*distances)[i];
+                best->frame = node.begin + i;
+            }
+        }
+        return;
+    }
+    // Nearer child first, bounding boxes are much tighter than the cells split by the tree in many dimensions
+    double left_distance = boxDistance(node.left, feature);
+    double right_distance = boxDistance(node.right, feature);
+    int near = left_distance <= right_distance ? node.left : node.right;
+    int far = left_distance <= right_distance ? node.right : node.left;
+    double near_distance = std::min(left_distance, right_distance);
+    double far_distance = std::max(left_distance, right_distance);
+    if (near_distance * scale < best->distance) searchNode(near, feature, scale, best, distances);
+    if (far_distance * scale < best->distance) searchNode(far, feature, scale, best, distances);
+}
+}  // namespace kinematics
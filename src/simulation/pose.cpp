@@ -0,0 +1,48 @@
+#include "simulation/pose.h"
+
+#include "acclaim/skeleton.h"
+#include "util/simd.h"
+
+namespace kinematics {
+SkeletonPose::SkeletonPose() noexcept {}
+
+SkeletonPose::SkeletonPose(const std::size_t size) noexcept
+    : start_positions(size, Eigen::Vector4d::Zero()),
+      end_positions(size, Eigen::Vector4d::Zero()),
+      rotations(size, Eigen::Quaterniond::Identity()) {}
+
+int SkeletonPose::getBoneNum() const { return static_cast<int>(rotations.size()); }
+
+void capturePose(acclaim::Skeleton* skeleton, SkeletonPose* pose) {
+    int total_bones = skeleton->getBoneNum();
+    if (pose->getBoneNum() != total_bones) *pose = SkeletonPose(total_bones);
+    for (int i = 0; i < total_bones; ++i) {
+        const acclaim::Bone& bone = *skeleton->getBonePointer(i);
+        pose->start_positions[i] = bone.start_position;
+        pose->end_positions[i] = bone.end_position;
+        pose->rotations[i] = Eigen::Quaterniond(bone.rotation.linear());
+    }
+}
+
+void applyPose(const SkeletonPose& pose, acclaim::Skeleton* skeleton) {
+    for (int i = 0; i < pose.getBoneNum(); ++i) {
+        acclaim::Bone& bone = *skeleton->getBonePointer(i);
+        bone.start_position = pose.start_positions[i];
+        bone.end_position = pose.end_positions[i];
+        bone.rotation = pose.rotations[i];
+    }
+}
+
+void blendPose(const SkeletonPose& from, const SkeletonPose& to, double t, acclaim::Skeleton* skeleton) {
+    static thread_local std::vector<Eigen::Quaterniond> rotations;
+    rotations.resize(from.rotations.size());
+    util::simd::kernels().slerp(from.rotations[0].coeffs().data(), to.rotations[0].coeffs().data(), t,
+                                rotations[0].coeffs().data(), rotations.size());
+    for (int i = 0; i < from.getBoneNum(); ++i) {
+        acclaim::Bone& bone = *skeleton->getBonePointer(i);
+        bone.start_position = from.start_positions[i] + t * (to.start_positions[i] - from.start_positions[i]);
+        bone.end_position = from.end_positions[i] + t * (to.end_positions[i] - from.end_positions[i]);
+        bone.rotation = rotations[i];
+    }
+}
+}  // namespace kinematics
@@ -0,0 +1,90 @@
+#include "simulation/pose_cache.h"
+
+#include <utility>
+
+#include "acclaim/motion.h"
+#include "simulation/kinematics.h"
+#include "util/simd.h"
+
+namespace kinematics {
+RootRelativePoseCache::RootRelativePoseCache(acclaim::Motion* _motion) noexcept : motion(_motion) { clear(); }
+
+RootRelativePoseCache::RootRelativePoseCache(RootRelativePoseCache&& other) noexcept
+    : motion(other.motion),
+      cached(std::move(other.cached)),
+      poses(std::move(other.poses)),
+      root_transforms(std::move(other.root_transforms)) {}
+
+RootRelativePoseCache& RootRelativePoseCache::operator=(RootRelativePoseCache&& other) noexcept {
+    if (this != &other) {
+        motion = other.motion;
+        cached = std::move(other.cached);
+        poses = std::move(other.poses);
+        root_transforms = std::move(other.root_transforms);
+    }
+    return *this;
+}
+
+const SkeletonPose& RootRelativePoseCache::getPose(int frame_idx) {
+    if (!cached[frame_idx]) solve(frame_idx);
+    return poses[frame_idx];
+}
+
+const Eigen::Affine3d& RootRelativePoseCache::getRootTransform(int frame_idx) {
+    if (!cached[frame_idx]) solve(frame_idx);
+    return root_transforms[frame_idx];
+}
+
+void RootRelativePoseCache::apply(int frame_idx, const Eigen::Affine3d& instance, acclaim::Skeleton* skeleton) {
+    const SkeletonPose& pose = getPose(frame_idx);
+    static thread_local SkeletonPose placed;
+    if (placed.getBoneNum() != pose.getBoneNum()) placed = SkeletonPose(pose.getBoneNum());
+    Eigen::Affine3d root = instance * root_transforms[frame_idx];
+    Eigen::Quaterniond root_rotation(root.linear());
+    const util::simd::Kernels& kernels = util::simd::kernels();
+    // Positions are stored with w = 0, the kernel transforms them as points and keeps w
+    kernels.transformPoints(root.data(), pose.start_positions[0].data(), placed.start_positions[0].data(),
+                            pose.start_positions.size());
+    kernels.transformPoints(root.data(), pose.end_positions[0].data(), placed.end_positions[0].data(),
+                            pose.end_positions.size());
+    kernels.rotateQuaternions(root_rotation.coeffs().data(), pose.rotations[0].coeffs().data(),
+                              placed.rotations[0].coeffs().data(), pose.rotations.size());
+    applyPose(placed, skeleton);
+}
+
+void RootRelativePoseCache::build() {
+    for (int i = 0; i < motion->getFrameNum(); ++i) {
+        if (!cached[i]) solve(i);
+    }
+}
+
+void RootRelativePoseCache::clear() {
+    int total_frames = motion->getFrameNum();
+    cached.assign(total_frames, false);
+    poses.resize(total_frames);
+    root_transforms.resize(total_frames, Eigen::Affine3d::Identity());
+}
+
+void RootRelativePoseCache::solve(int frame_idx) {
+    // Solve on the clip's own skeleton, instances overwrite it with apply() anyway
+    acclaim::Skeleton* skeleton = motion->getSkeleton().get();
+    acclaim::Bone* root_bone = skeleton->getBonePointer(acclaim::Skeleton::root_idx());
+    forwardSolver(motion->getPosture(frame_idx), root_bone);
+    capturePose(skeleton, &poses[frame_idx]);
+    // Root transform of the clip
+    Eigen::Affine3d root = Eigen::Affine3d::Identity();
+    root.linear() = root_bone->rotation.linear();
+    root.translation() = root_bone->start_position.head<3>();
+    root_transforms[frame_idx] = root;
+    // Move everything into root-local space
+    Eigen::Affine3d inverse = root.inverse(Eigen::Isometry);
+    Eigen::Quaterniond inverse_rotation(inverse.linear());
+    SkeletonPose& pose = poses[frame_idx];
+    for (int i = 0; i < pose.getBoneNum(); ++i) {
+        pose.start_positions[i].head<3>() = inverse * pose.start_positions[i].head<3>();
+        pose.end_positions[i].head<3>() = inverse * pose.end_positions[i].head<3>();
+        pose.rotations[i] = inverse_rotation * pose.rotations[i];
+    }
+    cached[frame_idx] = true;
+}
+}  // namespace kinematics
@@ -0,0 +1,188 @@
+#include "simulation/quantization.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "acclaim/skeleton.h"
+#include "simulation/kinematics.h"
+#include "util/helper.h"
+#include "util/simd.h"
+
+namespace kinematics {
+namespace {
+constexpr double max_word = 65535.0;
+// Smallest three components lie within +-1/sqrt(2)
+constexpr double component_range = 0.70710678118654752;
+constexpr double max_component_word = 32767.0;
+
+std::uint16_t quantizeComponent(double value) {
+    double unit = std::clamp(0.5 * (value / component_range + 1.0), 0.0, 1.0);
+    return static_cast<std::uint16_t>(std::lround(unit * max_component_word));
+}
+
+double dequantizeComponent(std::uint16_t word) {
+    return ((word & 0x7fff) / max_component_word * 2.0 - 1.0) * component_range;
+}
+
+// Largest joint position error between the source postures and what the solver gets from the words
+double measureError(acclaim::Skeleton* skeleton, const std::vector<acclaim::Posture>& postures,
+                    const QuantizedPostures& quantized) {
+    const int total_bones = skeleton->getBoneNum();
+    std::vector<Eigen::Vector4d> reference(total_bones, Eigen::Vector4d::Zero());
+    double error = 0.0;
+    for (int i = 0; i < quantized.getFrameNum(); ++i) {
+        forwardSolverBatch(postures[i], skeleton);
+        for (int j = 0; j < total_bones; ++j) reference[j] = skeleton->getBonePointer(j)->end_position;
+        forwardSolverQuantized(quantized, i, skeleton);
+        for (int j = 0; j < total_bones; ++j) {
+            error = std::max(error, (skeleton->getBonePointer(j)->end_position - reference[j]).norm());
+        }
+    }
+    return error;
+}
+}  // namespace
+
+QuantizedPostures::QuantizedPostures() noexcept {}
+
+QuantizedPostures::QuantizedPostures(acclaim::Skeleton* skeleton,
+                                     const std::vector<acclaim::Posture>& postures) noexcept
+    : frame_num(static_cast<int>(postures.size())), bone_num(skeleton->getBoneNum()) {
+    if (frame_num == 0) return;
+    quaternions = !postures[0].bone_quaternions.empty();
+    channels.resize(6 * bone_num);
+    // Ranges first, words are laid out after the channels that change are known
+    for (int j = 0; j < bone_num; ++j) {
+        for (int k = quaternions ? 3 : 0; k < 6; ++k) {
+            double low = k < 3 ? postures[0].bone_rotations[j][k] : postures[0].bone_translations[j][k - 3];
+            double high = low;
+            for (const acclaim::Posture& posture : postures) {
+                double value = k < 3 ? posture.bone_rotations[j][k] : posture.bone_translations[j][k - 3];
+                low = std::min(low, value);
+                high = std::max(high, value);
+            }
+            Channel& channel = channels[6 * j + k];
+            channel.minimum = low;
+            channel.step = (high - low) / max_word;
+            if (high > low) channel.offset = stride++;
+        }
+    }
+    if (quaternions) {
+        quaternion_offsets.assign(bone_num, -1);
+        constant_quaternions.resize(bone_num);
+        for (int j = 0; j < bone_num; ++j) {
+            constant_quaternions[j] = postures[0].bone_quaternions[j];
+            bool constant = true;
+            for (const acclaim::Posture& posture : postures) {
+                constant = constant && posture.bone_quaternions[j].coeffs() == constant_quaternions[j].coeffs();
+            }
+            if (!constant) {
+                quaternion_offsets[j] = stride;
+                stride += 3;
+            }
+        }
+    }
+    words.resize(static_cast<std::size_t>(frame_num) * stride);
+    for (int i = 0; i < frame_num; ++i) {
+        const acclaim::Posture& posture = postures[i];
+        std::uint16_t* frame = &words[static_cast<std::size_t>(i) * stride];
+        for (int j = 0; j < bone_num; ++j) {
+            for (int k = quaternions ? 3 : 0; k < 6; ++k) {
+                const Channel& channel = channels[6 * j + k];
+                if (channel.offset < 0) continue;
+                double value = k < 3 ? posture.bone_rotations[j][k] : posture.bone_translations[j][k - 3];
+                frame[channel.offset] =
+                    static_cast<std::uint16_t>(std::lround((value - channel.minimum) / channel.step));
+            }
+            if (!quaternions || quaternion_offsets[j] < 0) continue;
+            // Drop the largest component, its sign is made positive and it is rebuilt from the unit length
+            Eigen::Vector4d coefficients = posture.bone_quaternions[j].normalized().coeffs();
+            int largest;
+            coefficients.cwiseAbs().maxCoeff(&largest);
+            if (coefficients[largest] < 0.0) coefficients = -coefficients;
+            std::uint16_t* rotation_words = frame + quaternion_offsets[j];
+            for (int k = 0, word = 0; k < 4; ++k) {
+                if (k != largest) rotation_words[word++] = quantizeComponent(coefficients[k]);
+            }
+            rotation_words[0] |= static_cast<std::uint16_t>((largest & 1) << 15);
+            rotation_words[1] |= static_cast<std::uint16_t>((largest >> 1) << 15);
+        }
+    }
+    error = measureError(skeleton, postures, *this);
+}
+
+int QuantizedPostures::getFrameNum() const { return frame_num; }
+
+int QuantizedPostures::getBoneNum() const { return bone_num; }
+
+std::size_t QuantizedPostures::getByteSize() const {
+    return words.size() * sizeof(std::uint16_t) + channels.size() * sizeof(Channel) +
+           quaternion_offsets.size() * sizeof(int) + constant_quaternions.size() * sizeof(Eigen::Quaterniond);
+}
+
+double QuantizedPostures::getError() const { return error; }
+
+void QuantizedPostures::getPosture(int frame_idx, acclaim::Posture* posture) const {
+    if (posture->bone_rotations.size() != static_cast<std::size_t>(bone_num)) *posture = acclaim::Posture(bone_num);
+    const std::uint16_t* frame = &words[static_cast<std::size_t>(frame_idx) * stride];
+    if (quaternions) {
+        posture->bone_quaternions.resize(bone_num);
+        for (int j = 0; j < bone_num; ++j) {
+            posture->bone_quaternions[j] = rotation(frame, j);
+            posture->bone_rotations[j] = util::toDegreeZYX(posture->bone_quaternions[j]);
+        }
+    } else {
+        posture->bone_quaternions.clear();
+        dequantizeEuler(frame, posture->bone_rotations[0].data());
+    }
+    for (int j = 0; j < bone_num; ++j) {
+        for (int k = 0; k < 3; ++k) posture->bone_translations[j][k] = channelValue(frame, channels[6 * j + 3 + k]);
+        posture->bone_translations[j][3] = 0.0;
+    }
+}
+
+void QuantizedPostures::dequantize(int frame_idx, double* quaternions_out, double* translations) const {
+    const std::uint16_t* frame = &words[static_cast<std::size_t>(frame_idx) * stride];
+    if (quaternions) {
+        for (int j = 0; j < bone_num; ++j) {
+            Eigen::Map<Eigen::Vector4d>(quaternions_out + 4 * j) = rotation(frame, j).coeffs();
+        }
+    } else {
+        static thread_local std::vector<double> euler;
+        euler.resize(4 * static_cast<std::size_t>(bone_num));
+        dequantizeEuler(frame, euler.data());
+        util::simd::kernels().eulerToQuaternionZYX(euler.data(), util::PI / 180.0, quaternions_out, bone_num);
+    }
+    for (int j = 0; j < bone_num; ++j) {
+        for (int k = 0; k < 3; ++k) translations[4 * j + k] = channelValue(frame, channels[6 * j + 3 + k]);
+        translations[4 * j + 3] = 0.0;
+    }
+}
+
+void QuantizedPostures::dequantizeEuler(const std::uint16_t* frame, double* euler) const {
+    for (int j = 0; j < bone_num; ++j) {
+        for (int k = 0; k < 3; ++k) euler[4 * j + k] = channelValue(frame, channels[6 * j + k]);
+        euler[4 * j + 3] = 0.0;
+    }
+}
+
+double QuantizedPostures::channelValue(const std::uint16_t* frame, const Channel& channel) const {
+    return channel.offset < 0 ? channel.minimum : channel.minimum + frame[channel.offset] * channel.step;
+}
+
+Eigen::Quaterniond QuantizedPostures::rotation(const std::uint16_t* frame, int bone_idx) const {
+    if (quaternion_offsets[bone_idx] < 0) return constant_quaternions[bone_idx];
+    const std::uint16_t* rotation_words = frame + quaternion_offsets[bone_idx];
+    int largest = (rotation_words[0] >> 15) | ((rotation_words[1] >> 15) << 1);
+    Eigen::Vector4d coefficients;
+    double squared = 0.0;
+    for (int k = 0, word = 0; k < 4; ++k) {
+        if (k == largest) continue;
+        coefficients[k] = dequantizeComponent(rotation_words[word++]);
+        squared += coefficients[k] * coefficients[k];
+    }
+    coefficients[largest] = std::sqrt(std::max(1.0 - squared, 0.0));
+    Eigen::Quaterniond result;
+    result.coeffs() = coefficients.normalized();
+    return result;
+}
+}  // namespace kinematics
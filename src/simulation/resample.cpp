@@ -0,0 +1,92 @@
+#include "simulation/resample.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/helper.h"
+#include "util/simd.h"
+#include "util/thread_pool.h"
+
+namespace kinematics {
+void resample(const std::vector<acclaim::Posture>& postures, double source_rate, const ResampleOptions& options,
+              std::vector<acclaim::Posture>* resampled) {
+    int total_frames = static_cast<int>(postures.size());
+    if (total_frames == 0 || source_rate <= 0.0 || options.target_rate <= 0.0) {
+        resampled->clear();
+        return;
+    }
+    std::size_t total_bones = postures[0].bone_rotations.size();
+    // Source frames per output frame
+    double step = source_rate / options.target_rate;
+    std::size_t output_frames = static_cast<std::size_t>(std::floor((total_frames - 1) / step)) + 1;
+    // Tent filter half width in source frames, 1 is plain linear interpolation
+    double radius = options.anti_aliasing ? std::max(1.0, step) : 1.0;
+
+    util::ThreadPool& pool = util::ThreadPool::global();
+    // Quaternion track of every source frame, each is read by several output frames
+    std::vector<Eigen::Quaterniond> rotations(total_frames * total_bones, Eigen::Quaterniond::Identity());
+    pool.parallelFor(total_frames, 16, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const acclaim::Posture& posture = postures[i];
+            if (posture.bone_quaternions.empty()) {
+                util::rotateDegreeZYX(posture.bone_rotations.data(), &rotations[i * total_bones], total_bones);
+            } else {
+                std::copy(posture.bone_quaternions.begin(), posture.bone_quaternions.end(),
+                          rotations.begin() + i * total_bones);
+            }
+        }
+    });
+
+    resampled->resize(output_frames);
+    pool.parallelFor(output_frames, 16, [&](std::size_t begin, std::size_t end) {
+        const util::simd::Kernels& kernels = util::simd::kernels();
+        std::vector<double> weights;
+        for (std::size_t i = begin; i < end; ++i) {
+            acclaim::Posture& output = (*resampled)[i];
+            output.bone_rotations.resize(total_bones);
+            output.bone_translations.assign(total_bones, Eigen::Vector4d::Zero());
+            output.bone_quaternions.resize(total_bones);
+            double center = std::min(i * step, double(total_frames - 1));
+            int first = std::max(0, static_cast<int>(std::floor(center - radius)) + 1);
+            int last = std::min(total_frames - 1, static_cast<int>(std::ceil(center + radius)) - 1);
+            // Tent weights, first == last when center lands on a frame with radius 1
+            weights.resize(last - first + 1);
+            double weight_sum = 0.0;
+            for (int k = first; k <= last; ++k) {
+                weights[k - first] = 1.0 - std::abs(k - center) / radius;
+                weight_sum += weights[k - first];
+            }
+            for (double& weight : weights) weight /= weight_sum;
+            for (int k = first; k <= last; ++k) {
+                double weight = weights[k - first];
+                for (std::size_t j = 0; j < total_bones; ++j) {
+                    output.bone_translations[j] += weight * postures[k].bone_translations[j];
+                }
+            }
+            Eigen::Quaterniond* output_rotations = output.bone_quaternions.data();
+            const Eigen::Quaterniond* first_rotations = &rotations[first * total_bones];
+            if (last - first <= 1) {
+                // Two frames at most, same as nlerp between them
+                double t = last == first ? 0.0 : weights[1];
+                kernels.nlerp(first_rotations->coeffs().data(), rotations[last * total_bones].coeffs().data(), t,
+                              output_rotations->coeffs().data(), total_bones);
+            } else {
+                // Weighted average on the hemisphere of the first frame, then normalize
+                for (std::size_t j = 0; j < total_bones; ++j) output_rotations[j].coeffs().setZero();
+                for (int k = first; k <= last; ++k) {
+                    const Eigen::Quaterniond* frame_rotations = &rotations[k * total_bones];
+                    for (std::size_t j = 0; j < total_bones; ++j) {
+                        double sign = frame_rotations[j].dot(first_rotations[j]) < 0.0 ? -1.0 : 1.0;
+                        output_rotations[j].coeffs() += (sign * weights[k - first]) * frame_rotations[j].coeffs();
+                    }
+                }
+                for (std::size_t j = 0; j < total_bones; ++j) output_rotations[j].normalize();
+            }
+            for (std::size_t j = 0; j < total_bones; ++j) {
+                output.bone_rotations[j] = options.euler_angles ? util::toDegreeZYX(output_rotations[j])
+                                                                : postures[first].bone_rotations[j];
+            }
+        }
+    });
+}
+}  // namespace kinematics
@@ -0,0 +1,130 @@
+#include "simulation/root_motion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#include "acclaim/bone.h"
+#include "acclaim/skeleton.h"
+#include "simulation/filter.h"
+#include "util/helper.h"
+#include "util/simd.h"
+
+namespace kinematics {
+namespace {
+// Planar transforms (x, z, heading) compose like rotations around y. Points on the floor are handled as
+// complex numbers z + ix, which a heading of a multiplies by e^(ia)
+std::complex<double> floorPoint(const Eigen::Vector3d& transform) { return {transform[1], transform[0]}; }
+
+Eigen::Vector3d makePlanar(std::complex<double> point, double heading) {
+    return Eigen::Vector3d(point.imag(), point.real(), heading);
+}
+
+Eigen::Vector3d compose(const Eigen::Vector3d& a, const Eigen::Vector3d& b) {
+    return makePlanar(floorPoint(a) + std::polar(1.0, a[2]) * floorPoint(b), a[2] + b[2]);
+}
+
+Eigen::Vector3d inverse(const Eigen::Vector3d& a) { return makePlanar(-std::polar(1.0, -a[2]) * floorPoint(a), -a[2]); }
+
+// a applied count times (negative count applies the inverse), in closed form so long playback stays cheap
+Eigen::Vector3d power(const Eigen::Vector3d& a, double count) {
+    std::complex<double> rotation = std::polar(1.0, a[2]);
+    // Geometric series of the rotation, count * translation when there is (almost) no turning
+    std::complex<double> series = std::abs(a[2]) < 1e-9 ? std::complex<double>(count, 0.0)
+                                                        : (1.0 - std::polar(1.0, count * a[2])) / (1.0 - rotation);
+    return makePlanar(series * floorPoint(a), count * a[2]);
+}
+
+Eigen::Affine3d toTransform(const Eigen::Vector3d& planar) {
+    Eigen::Affine3d transform = Eigen::Affine3d::Identity();
+    transform.linear() = Eigen::AngleAxisd(planar[2], Eigen::Vector3d::UnitY()).toRotationMatrix();
+    transform.translation() << planar[0], 0.0, planar[1];
+    return transform;
+}
+}  // namespace
+
+int RootTrajectory::getFrameNum() const { return static_cast<int>(samples.size()); }
+
+Eigen::Affine3d RootTrajectory::getTransform(int frame_idx) const { return toTransform(samples[frame_idx]); }
+
+Eigen::Affine3d RootTrajectory::sample(double seconds) const {
+    int total_frames = getFrameNum();
+    if (total_frames == 0) return Eigen::Affine3d::Identity();
+    if (total_frames == 1) return toTransform(samples[0]);
+    // Same period as the looping playback (Motion::getDuration), the frame after the last one moves
+    // with the last frame's velocity and lands on frame 0 of the next loop
+    Eigen::Vector3d after_last = compose(samples.back(), compose(inverse(samples[total_frames - 2]), samples.back()));
+    Eigen::Vector3d loop = compose(after_last, inverse(samples[0]));
+    double frame = seconds * frame_rate;
+    double loops = std::floor(frame / total_frames);
+    frame -= loops * total_frames;
+    int from = std::min(static_cast<int>(frame), total_frames - 1);
+    double t = frame - from;
+    Eigen::Vector3d from_sample = samples[from];
+    Eigen::Vector3d to_sample = from + 1 < total_frames ? samples[from + 1] : after_last;
+    return toTransform(compose(power(loop, loops), from_sample + t * (to_sample - from_sample)));
+}
+
+void extractRootMotion(acclaim::Skeleton* skeleton, double frame_rate, const RootMotionOptions& options,
+                       std::vector<acclaim::Posture>* postures, RootTrajectory* trajectory) {
+    std::size_t total_frames = postures->size();
+    trajectory->frame_rate = frame_rate;
+    trajectory->samples.resize(total_frames);
+    if (total_frames == 0) return;
+    std::size_t total_bones = (*postures)[0].bone_rotations.size();
+    Eigen::Quaterniond rest(skeleton->getBonePointer(acclaim::Skeleton::root_idx())->rot_parent_current.linear());
+
+    // Floor position and heading of the root in channel-major layout
+    std::vector<double> channels(3 * total_frames), smoothed(3 * total_frames);
+    double* x = channels.data();
+    double* z = x + total_frames;
+    double* heading = z + total_frames;
+    for (std::size_t i = 0; i < total_frames; ++i) {
+        acclaim::Posture& posture = (*postures)[i];
+        if (posture.bone_quaternions.empty()) {
+            posture.bone_quaternions.resize(total_bones);
+            util::rotateDegreeZYX(posture.bone_rotations.data(), posture.bone_quaternions.data(), total_bones);
+        }
+        Eigen::Vector3d facing = rest * posture.bone_quaternions[0] * Eigen::Vector3d::UnitZ();
+        x[i] = posture.bone_translations[0][0];
+        z[i] = posture.bone_translations[0][2];
+        heading[i] = std::atan2(facing.x(), facing.z());
+        if (i > 0) heading[i] -= 2.0 * util::PI * std::round((heading[i] - heading[i - 1]) / (2.0 * util::PI));
+    }
+    // Pad with point reflections around the end samples so that the path keeps its speed at both ends,
+    // repeating the end samples would slow it down there
+    std::vector<double> taps = gaussianTaps(options.smoothing * frame_rate);
+    std::size_t radius = taps.size() / 2;
+    std::vector<double> padded(total_frames + 2 * radius), padded_smoothed(padded.size());
+    const util::simd::Kernels& kernels = util::simd::kernels();
+    for (int c = 0; c < 3; ++c) {
+        const double* channel = &channels[c * total_frames];
+        for (std::size_t k = 1; k <= radius; ++k) {
+            std::size_t mirror = std::min(k, total_frames - 1);
+            padded[radius - k] = 2.0 * channel[0] - channel[mirror];
+            padded[radius + total_frames - 1 + k] =
+                2.0 * channel[total_frames - 1] - channel[total_frames - 1 - mirror];
+        }
+        std::copy(channel, channel + total_frames, padded.begin() + radius);
+        kernels.convolve(padded.data(), padded.size(), taps.data(), taps.size(), padded_smoothed.data());
+        std::copy(padded_smoothed.begin() + radius, padded_smoothed.begin() + radius + total_frames,
+                  smoothed.begin() + c * total_frames);
+    }
+
+    // Root relative to the path: path^-1 * root
+    Eigen::Quaterniond rest_inverse = rest.conjugate();
+    for (std::size_t i = 0; i < total_frames; ++i) {
+        Eigen::Vector3d& planar = trajectory->samples[i];
+        planar << smoothed[i], smoothed[total_frames + i], smoothed[2 * total_frames + i];
+        Eigen::Quaterniond path_inverse(Eigen::AngleAxisd(-planar[2], Eigen::Vector3d::UnitY()));
+        acclaim::Posture& posture = (*postures)[i];
+        Eigen::Vector4d& translation = posture.bone_translations[0];
+        Eigen::Vector3d local = path_inverse * Eigen::Vector3d(translation[0] - planar[0], translation[1],
+                                                               translation[2] - planar[1]);
+        translation.head<3>() = local;
+        Eigen::Quaterniond& rotation = posture.bone_quaternions[0];
+        rotation = (rest_inverse * path_inverse * rest * rotation).normalized();
+        posture.bone_rotations[0] = util::toDegreeZYX(rotation);
+    }
+}
+}  // namespace kinematics
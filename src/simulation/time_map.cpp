@@ -0,0 +1,97 @@
+#include "simulation/time_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+
+namespace kinematics {
+PiecewiseTimeMap::PiecewiseTimeMap(Interpolation _interpolation) noexcept : interpolation(_interpolation) {}
+
+bool PiecewiseTimeMap::addKey(double warped_frame, double source_frame) {
+    auto position = std::lower_bound(warped_keys.begin(), warped_keys.end(), warped_frame);
+    std::size_t i = std::distance(warped_keys.begin(), position);
+    bool replace = position != warped_keys.end() && *position == warped_frame;
+    // Neighbours after insertion must stay strictly increasing in both frames
+    bool monotone = (i == 0 || source_keys[i - 1] < source_frame) &&
+                    (i + (replace ? 1 : 0) >= source_keys.size() || source_frame < source_keys[i + (replace ? 1 : 0)]);
+    if (!monotone) {
+        std::cerr << "Time map key (" << warped_frame << ", " << source_frame << ") breaks monotonicity" << std::endl;
+        return false;
+    }
+    if (replace) {
+        source_keys[i] = source_frame;
+    } else {
+        warped_keys.insert(position, warped_frame);
+        source_keys.insert(source_keys.begin() + i, source_frame);
+    }
+    updateTangents();
+    return true;
+}
+
+void PiecewiseTimeMap::clear() {
+    warped_keys.clear();
+    source_keys.clear();
+    tangents.clear();
+}
+
+int PiecewiseTimeMap::getKeyNum() const { return static_cast<int>(warped_keys.size()); }
+
+PiecewiseTimeMap::Interpolation PiecewiseTimeMap::getInterpolation() const { return interpolation; }
+
+void PiecewiseTimeMap::setInterpolation(Interpolation _interpolation) {
+    interpolation = _interpolation;
+    updateTangents();
+}
+
+double PiecewiseTimeMap::evaluate(double warped_frame) const {
+    // Last key not after warped_frame, -1 if before all keys
+    int i = static_cast<int>(std::upper_bound(warped_keys.begin(), warped_keys.end(), warped_frame) -
+                             warped_keys.begin()) - 1;
+    return evaluateSegment(i, warped_frame);
+}
+
+double PiecewiseTimeMap::operator()(int warped_frame) const { return evaluate(warped_frame); }
+
+void PiecewiseTimeMap::evaluateSorted(const double* warped_frames, double* source_frames, std::size_t n) const {
+    int i = -1;
+    int last = getKeyNum() - 1;
+    for (std::size_t k = 0; k < n; ++k) {
+        // Only moves forward, so every key is passed once
+        while (i < last && warped_keys[i + 1] <= warped_frames[k]) ++i;
+        source_frames[k] = evaluateSegment(i, warped_frames[k]);
+    }
+}
+
+double PiecewiseTimeMap::evaluateSegment(int i, double warped_frame) const {
+    if (warped_keys.empty()) return warped_frame;
+    if (i < 0) return source_keys.front() + (warped_frame - warped_keys.front());
+    if (i + 1 >= getKeyNum()) return source_keys.back() + (warped_frame - warped_keys.back());
+    double width = warped_keys[i + 1] - warped_keys[i];
+    double t = (warped_frame - warped_keys[i]) / width;
+    if (interpolation == Interpolation::Linear) return source_keys[i] + t * (source_keys[i + 1] - source_keys[i]);
+    // Cubic Hermite basis
+    double t2 = t * t, t3 = t2 * t;
+    double h00 = 2 * t3 - 3 * t2 + 1, h10 = t3 - 2 * t2 + t;
+    double h01 = -2 * t3 + 3 * t2, h11 = t3 - t2;
+    return h00 * source_keys[i] + h10 * width * tangents[i] + h01 * source_keys[i + 1] +
+           h11 * width * tangents[i + 1];
+}
+
+void PiecewiseTimeMap::updateTangents() {
+    std::size_t key_num = warped_keys.size();
+    tangents.assign(key_num, 1.0);
+    if (interpolation != Interpolation::Cubic || key_num < 2) return;
+    std::vector<double> slopes(key_num - 1);
+    for (std::size_t i = 0; i + 1 < key_num; ++i) {
+        slopes[i] = (source_keys[i + 1] - source_keys[i]) / (warped_keys[i + 1] - warped_keys[i]);
+    }
+    // End keys blend into the slope 1 extrapolation, inner keys use the harmonic mean (Fritsch-Butland)
+    // which keeps every segment monotone
+    for (std::size_t i = 0; i < key_num; ++i) {
+        double left = i == 0 ? 1.0 : slopes[i - 1];
+        double right = i + 1 == key_num ? 1.0 : slopes[i];
+        tangents[i] = 2.0 * left * right / (left + right);
+    }
+}
+}  // namespace kinematics
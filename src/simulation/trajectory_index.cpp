@@ -0,0 +1,251 @@
+#include "simulation/trajectory_index.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+#include "acclaim/motion.h"
+#include "simulation/features.h"
+#include "simulation/kinematics.h"
+#include "util/thread_pool.h"
+
+namespace kinematics {
+namespace {
+// Slab test of the straight path from -> to against the box
+bool pathIntersects(const Eigen::Vector3d& from, const Eigen::Vector3d& to, const Eigen::AlignedBox3d& box) {
+    double enter = 0.0, leave = 1.0;
+    Eigen::Vector3d direction = to - from;
+    for (int k = 0; k < 3; ++k) {
+        if (direction[k] == 0.0) {
+            if (from[k] < box.min()[k] || from[k] > box.max()[k]) return false;
+            continue;
+        }
+        double near = (box.min()[k] - from[k]) / direction[k];
+        double far = (box.max()[k] - from[k]) / direction[k];
+        if (near > far) std::swap(near, far);
+        enter = std::max(enter, near);
+        leave = std::min(leave, far);
+        if (enter > leave) return false;
+    }
+    return true;
+}
+
+double pathDistance(const Eigen::Vector3d& from, const Eigen::Vector3d& to, const Eigen::Vector3d& point) {
+    Eigen::Vector3d direction = to - from;
+    double length = direction.squaredNorm();
+    double t = length > 0.0 ? std::clamp((point - from).dot(direction) / length, 0.0, 1.0) : 0.0;
+    return (from + t * direction - point).norm();
+}
+
+void sortHits(std::vector<TrajectoryHit>* hits) {
+    std::sort(hits->begin(), hits->end(), [](const TrajectoryHit& a, const TrajectoryHit& b) {
+        return a.clip != b.clip ? a.clip < b.clip : a.frame < b.frame;
+    });
+}
+}  // namespace
+
+TrajectoryIndex::TrajectoryIndex(const TrajectoryIndexOptions& _options) noexcept : options(_options) {}
+
+int TrajectoryIndex::addMotion(const std::string& name, acclaim::Motion* motion) {
+    acclaim::Skeleton* skeleton = motion->getSkeleton().get();
+    if (options.bones.empty() && getClipNum() == 0) {
+        for (int i = 0; i < skeleton->getBoneNum(); ++i) options.bones.push_back(skeleton->getBonePointer(i)->name);
+    }
+    std::vector<int> bones;
+    if (!findBones(skeleton, options.bones, name, &bones)) return -1;
+    int clip_idx = getClipNum();
+    int offset = getFrameNum();
+    int total_frames = motion->getFrameNum();
+    int total_bones = static_cast<int>(bones.size());
+    positions.resize(static_cast<std::size_t>(offset + total_frames) * total_bones * 3);
+    for (int i = 0; i < total_frames; ++i) {
+        forwardSolverBatch(motion->getPosture(i), skeleton);
+        double* frame = positions.data() + static_cast<std::size_t>(offset + i) * total_bones * 3;
+        for (int j = 0; j < total_bones; ++j) {
+            Eigen::Map<Eigen::Vector3d>(frame + 3 * j) = skeleton->getBonePointer(bones[j])->end_position.head<3>();
+        }
+    }
+    int segment_frames = std::max(options.segment_frames, 1);
+    for (int begin = 0; begin < total_frames; begin += segment_frames) {
+        segments.push_back({clip_idx, offset + begin, offset + std::min(begin + segment_frames, total_frames)});
+    }
+    clip_names.push_back(name);
+    clip_offsets.push_back(offset + total_frames);
+    // The trees do not cover the new clip, queries wait for build()
+    tree_segments.clear();
+    nodes.clear();
+    return clip_idx;
+}
+
+void TrajectoryIndex::build() {
+    int total_bones = static_cast<int>(options.bones.size());
+    tree_segments.assign(total_bones, std::vector<int>());
+    nodes.assign(total_bones, std::vector<Node>());
+    // Bones are independent, each worker builds whole trees
+    util::ThreadPool::global().parallelFor(total_bones, 1, [this](std::size_t begin, std::size_t end) {
+        std::vector<Eigen::AlignedBox3d> boxes(segments.size());
+        for (std::size_t bone_slot = begin; bone_slot < end; ++bone_slot) {
+            int slot = static_cast<int>(bone_slot);
+            for (std::size_t i = 0; i < segments.size(); ++i) boxes[i] = segmentBox(slot, segments[i]);
+            tree_segments[slot].resize(segments.size());
+            std::iota(tree_segments[slot].begin(), tree_segments[slot].end(), 0);
+            if (!segments.empty()) buildNode(slot, boxes, 0, static_cast<int>(segments.size()), &nodes[slot]);
+        }
+    });
+}
+
+int TrajectoryIndex::getClipNum() const { return static_cast<int>(clip_names.size()); }
+
+const std::string& TrajectoryIndex::getClipName(int clip_idx) const { return clip_names[clip_idx]; }
+
+int TrajectoryIndex::getFrameNum() const { return clip_offsets.back(); }
+
+const std::vector<std::string>& TrajectoryIndex::getBoneNames() const { return options.bones; }
+
+Eigen::Vector3d TrajectoryIndex::getPosition(const std::string& bone, int clip_idx, int frame_idx) const {
+    int bone_slot = findBone(bone);
+    if (bone_slot < 0) return Eigen::Vector3d::Zero();
+    return Eigen::Map<const Eigen::Vector3d>(position(bone_slot, clip_offsets[clip_idx] + frame_idx));
+}
+
+bool TrajectoryIndex::queryBox(const std::string& bone, const Eigen::AlignedBox3d& box,
+                               std::vector<TrajectoryHit>* hits) const {
+    hits->clear();
+    int bone_slot = findBone(bone);
+    if (bone_slot < 0 || !isBuilt()) return false;
+    Eigen::Vector3d from, to;
+    visit(
+        bone_slot, [&box](const Eigen::AlignedBox3d& node_box) { return node_box.intersects(box); },
+        [&](const Segment& segment) {
+            for (int i = segment.begin; i < segment.end; ++i) {
+                getPath(bone_slot, segment, i, &from, &to);
+                if (pathIntersects(from, to, box)) hits->push_back({segment.clip, i - clip_offsets[segment.clip], 0.0});
+            }
+        });
+    sortHits(hits);
+    return true;
+}
+
+bool TrajectoryIndex::queryRadius(const std::string& bone, const Eigen::Vector3d& center, double radius,
+                                  std::vector<TrajectoryHit>* hits) const {
+    hits->clear();
+    int bone_slot = findBone(bone);
+    if (bone_slot < 0 || !isBuilt()) return false;
+    Eigen::Vector3d from, to;
+    visit(
+        bone_slot,
+        [&center, radius](const Eigen::AlignedBox3d& node_box) { return node_box.exteriorDistance(center) <= radius; },
+        [&](const Segment& segment) {
+            for (int i = segment.begin; i < segment.end; ++i) {
+                getPath(bone_slot, segment, i, &from, &to);
+                double distance = pathDistance(from, to, center);
+                if (distance <= radius) hits->push_back({segment.clip, i - clip_offsets[segment.clip], distance});
+            }
+        });
+    sortHits(hits);
+    return true;
+}
+
+TrajectoryHit TrajectoryIndex::nearest(const std::string& bone, const Eigen::Vector3d& point) const {
+    TrajectoryHit best;
+    best.distance = std::numeric_limits<double>::infinity();
+    int bone_slot = findBone(bone);
+    if (bone_slot < 0 || !isBuilt()) return best;
+    // Best first, nodes come out nearest box first and the search stops once no box can be closer
+    using Candidate = std::pair<double, int>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue;
+    const std::vector<Node>& bone_nodes = nodes[bone_slot];
+    if (!bone_nodes.empty()) queue.emplace(bone_nodes[0].box.exteriorDistance(point), 0);
+    Eigen::Vector3d from, to;
+    while (!queue.empty() && queue.top().first < best.distance) {
+        const Node& node = bone_nodes[queue.top().second];
+        queue.pop();
+        if (node.left >= 0) {
+            queue.emplace(bone_nodes[node.left].box.exteriorDistance(point), node.left);
+            queue.emplace(bone_nodes[node.right].box.exteriorDistance(point), node.right);
+            continue;
+        }
+        for (int j = node.begin; j < node.end; ++j) {
+            const Segment& segment = segments[tree_segments[bone_slot][j]];
+            for (int i = segment.begin; i < segment.end; ++i) {
+                getPath(bone_slot, segment, i, &from, &to);
+                double distance = pathDistance(from, to, point);
+                if (distance < best.distance) best = {segment.clip, i - clip_offsets[segment.clip], distance};
+            }
+        }
+    }
+    return best;
+}
+
+bool TrajectoryIndex::isBuilt() const { return nodes.size() == options.bones.size(); }
+
+int TrajectoryIndex::findBone(const std::string& bone) const {
+    auto it = std::find(options.bones.begin(), options.bones.end(), bone);
+    return it == options.bones.end() ? -1 : static_cast<int>(it - options.bones.begin());
+}
+
+const double* TrajectoryIndex::position(int bone_slot, int frame) const {
+    return positions.data() + (static_cast<std::size_t>(frame) * options.bones.size() + bone_slot) * 3;
+}
+
+void TrajectoryIndex::getPath(int bone_slot, const Segment& segment, int frame, Eigen::Vector3d* from,
+                              Eigen::Vector3d* to) const {
+    int next = frame + 1 < clip_offsets[segment.clip + 1] ? frame + 1 : frame;
+    *from = Eigen::Map<const Eigen::Vector3d>(position(bone_slot, frame));
+    *to = Eigen::Map<const Eigen::Vector3d>(position(bone_slot, next));
+}
+
+Eigen::AlignedBox3d TrajectoryIndex::segmentBox(int bone_slot, const Segment& segment) const {
+    // Covers the path of the last frame to the first frame of the next segment as well
+    int last = std::min(segment.end, clip_offsets[segment.clip + 1] - 1);
+    Eigen::AlignedBox3d box;
+    for (int i = segment.begin; i <= last; ++i) box.extend(Eigen::Map<const Eigen::Vector3d>(position(bone_slot, i)));
+    return box;
+}
+
+int TrajectoryIndex::buildNode(int bone_slot, const std::vector<Eigen::AlignedBox3d>& boxes, int begin, int end,
+                               std::vector<Node>* bone_nodes) {
+    std::vector<int>& order = tree_segments[bone_slot];
+    Eigen::AlignedBox3d box, centers;
+    for (int i = begin; i < end; ++i) {
+        box.extend(boxes[order[i]]);
+        centers.extend(boxes[order[i]].center());
+    }
+    int node_idx = static_cast<int>(bone_nodes->size());
+    bone_nodes->push_back({box, begin, end, -1, -1});
+    // Split at the median segment along the widest spread of segment centers
+    int axis;
+    double widest = centers.sizes().maxCoeff(&axis);
+    if (end - begin <= std::max(options.leaf_size, 1) || widest <= 0.0) return node_idx;
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&](int a, int b) { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+    int left = buildNode(bone_slot, boxes, begin, middle, bone_nodes);
+    int right = buildNode(bone_slot, boxes, middle, end, bone_nodes);
+    (*bone_nodes)[node_idx].left = left;
+    (*bone_nodes)[node_idx].right = right;
+    return node_idx;
+}
+
+template <class NodeTest, class SegmentVisitor>
+void TrajectoryIndex::visit(int bone_slot, const NodeTest& test, const SegmentVisitor& visitor) const {
+    const std::vector<Node>& bone_nodes = nodes[bone_slot];
+    if (bone_nodes.empty()) return;
+    // Depth is about log2 of the segment count, no recursion needed
+    std::vector<int> stack = {0};
+    while (!stack.empty()) {
+        const Node& node = bone_nodes[stack.back()];
+        stack.pop_back();
+        if (!test(node.box)) continue;
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; ++i) visitor(segments[tree_segments[bone_slot][i]]);
+        } else {
+            stack.push_back(node.right);
+            stack.push_back(node.left);
+        }
+    }
+}
+}  // namespace kinematics
@@ -0,0 +1,30 @@
+#include "util/binary_io.h"
+
+#include <cstring>
+
+namespace util {
+void writeString(std::ostream& output, const std::string& value) {
+    writeValue(output, static_cast<std::uint64_t>(value.size()));
+    output.write(value.data(), value.size());
+}
+
+void writeHeader(std::ostream& output, const char magic[4], std::uint32_t version) {
+    output.write(magic, 4);
+    writeValue(output, version);
+}
+
+bool readString(std::istream& input, std::uint64_t file_size, std::string* value) {
+    std::uint64_t size;
+    if (!readValue(input, &size) || size > file_size) return false;
+    value->resize(size);
+    input.read(&(*value)[0], size);
+    return static_cast<bool>(input);
+}
+
+bool readHeader(std::istream& input, const char magic[4], std::uint32_t version) {
+    char file_magic[4];
+    std::uint32_t file_version;
+    return readArray(input, file_magic, 4) && std::memcmp(file_magic, magic, 4) == 0 &&
+           readValue(input, &file_version) && file_version == version;
+}
+}  // namespace util
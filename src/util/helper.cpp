@@ -1,6 +1,8 @@
 #include "util/helper.h"
 #include <cmath>
 
+#include "util/simd.h"
+
 namespace util {
 namespace {
 Eigen::AngleAxisd rotateRadianX(double x) { return Eigen::AngleAxisd(x, Eigen::Vector3d::UnitX()); }
@@ -59,6 +61,19 @@ Eigen::Quaterniond rotateDegreeXYZ(double x, double y, double z) {
     return rotateRadianXYZ(toRadian(x), toRadian(y), toRadian(z));
 }
 Eigen::Quaterniond rotateDegreeXYZ(const Eigen::Vector4d& rotation) { return rotateRadianXYZ(toRadian(rotation)); }
+void rotateDegreeZYX(const Eigen::Vector4d* rotations, Eigen::Quaterniond* quaternions, std::size_t n) {
+    if (n == 0) return;
+    simd::kernels().eulerToQuaternionZYX(rotations->data(), PI / 180.0, quaternions->coeffs().data(), n);
+}
+void rotateDegreeXYZ(const Eigen::Vector4d* rotations, Eigen::Quaterniond* quaternions, std::size_t n) {
+    if (n == 0) return;
+    simd::kernels().eulerToQuaternionXYZ(rotations->data(), PI / 180.0, quaternions->coeffs().data(), n);
+}
+Eigen::Vector4d toDegreeZYX(const Eigen::Quaterniond& rotation) {
+    // R = Rz(angles[0]) * Ry(angles[1]) * Rx(angles[2])
+    Eigen::Vector3d angles = rotation.toRotationMatrix().eulerAngles(2, 1, 0);
+    return toDegree(Eigen::Vector4d(angles[2], angles[1], angles[0], 0.0));
+}
 Eigen::Quaterniond rotateRadianZYX(double x, double y, double z) {
     return rotateRadianZ(z) * rotateRadianY(y) * rotateRadianX(x);
 }
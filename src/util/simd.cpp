@@ -0,0 +1,125 @@
+#include "util/simd.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SIMD_X86_CPUID 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define SIMD_X86_CPUID 1
+#else
+#define SIMD_X86_CPUID 0
+#endif
+
+namespace util {
+namespace simd {
+namespace detail {
+// Defined in simd_*.cpp, only those enabled in CMakeLists.txt are compiled
+const Kernels& kernelsGeneric();
+#ifdef FK_SIMD_SSE42
+const Kernels& kernelsSSE42();
+#endif
+#ifdef FK_SIMD_AVX2
+const Kernels& kernelsAVX2();
+#endif
+#ifdef FK_SIMD_AVX512
+const Kernels& kernelsAVX512();
+#endif
+}  // namespace detail
+
+namespace {
+#if SIMD_X86_CPUID
+void cpuid(int leaf, int subleaf, unsigned int registers[4]) {
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, leaf, subleaf);
+    for (int i = 0; i < 4; ++i) registers[i] = static_cast<unsigned int>(values[i]);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// XCR0 tells which register states the OS saves on context switch
+unsigned long long xgetbv() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+// Cap the instruction set by FK_SIMD environment variable (for testing slower code paths)
+InstructionSet environmentLimit() {
+    const char* value = std::getenv("FK_SIMD");
+    if (value == nullptr) return InstructionSet::AVX512;
+    if (std::strcmp(value, "generic") == 0) return InstructionSet::Generic;
+    if (std::strcmp(value, "sse4.2") == 0) return InstructionSet::SSE42;
+    if (std::strcmp(value, "avx2") == 0) return InstructionSet::AVX2;
+    return InstructionSet::AVX512;
+}
+}  // namespace
+
+InstructionSet detectInstructionSet() {
+#if SIMD_X86_CPUID
+    unsigned int registers[4] = {0, 0, 0, 0};
+    cpuid(0, 0, registers);
+    unsigned int max_leaf = registers[0];
+    if (max_leaf < 1) return InstructionSet::Generic;
+    cpuid(1, 0, registers);
+    const bool sse42 = (registers[2] & (1u << 20)) != 0;
+    const bool osxsave = (registers[2] & (1u << 27)) != 0;
+    const bool avx = (registers[2] & (1u << 28)) != 0;
+    const bool fma = (registers[2] & (1u << 12)) != 0;
+    if (!sse42) return InstructionSet::Generic;
+    if (!osxsave || !avx || max_leaf < 7) return InstructionSet::SSE42;
+    unsigned long long xcr0 = xgetbv();
+    // XMM and YMM state
+    if ((xcr0 & 0x6) != 0x6) return InstructionSet::SSE42;
+    cpuid(7, 0, registers);
+    const bool avx2 = (registers[1] & (1u << 5)) != 0;
+    const bool avx512f = (registers[1] & (1u << 16)) != 0;
+    const bool avx512dq = (registers[1] & (1u << 17)) != 0;
+    if (!avx2 || !fma) return InstructionSet::SSE42;
+    // Opmask, upper ZMM0-15 and ZMM16-31 state
+    if (!avx512f || !avx512dq || (xcr0 & 0xe0) != 0xe0) return InstructionSet::AVX2;
+    return InstructionSet::AVX512;
+#else
+    return InstructionSet::Generic;
+#endif
+}
+
+const Kernels& kernels(InstructionSet instruction_set) {
+    // Fall through to narrower builds when a variant is not compiled in
+    switch (instruction_set) {
+        case InstructionSet::AVX512:
+#ifdef FK_SIMD_AVX512
+            return detail::kernelsAVX512();
+#endif
+        case InstructionSet::AVX2:
+#ifdef FK_SIMD_AVX2
+            return detail::kernelsAVX2();
+#endif
+        case InstructionSet::SSE42:
+#ifdef FK_SIMD_SSE42
+            return detail::kernelsSSE42();
+#endif
+        default:
+            return detail::kernelsGeneric();
+    }
+}
+
+const Kernels& kernels() {
+    static const Kernels* selected = [] {
+        InstructionSet detected = detectInstructionSet();
+        InstructionSet limit = environmentLimit();
+        return &kernels(static_cast<int>(detected) < static_cast<int>(limit) ? detected : limit);
+    }();
+    return *selected;
+}
+}  // namespace simd
+}  // namespace util
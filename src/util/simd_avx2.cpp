@@ -0,0 +1,5 @@
+// AVX2 build of the math kernels, compiled with -mavx2 -mfma or /arch:AVX2 (see CMakeLists.txt)
+#define SIMD_KERNELS_NAME kernelsAVX2
+#define SIMD_INSTRUCTION_SET InstructionSet::AVX2
+#define SIMD_NAME "AVX2"
+#include "simd_kernels.inl"
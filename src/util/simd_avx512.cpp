@@ -0,0 +1,5 @@
+// AVX-512 build of the math kernels, compiled with -mavx512f -mavx512dq or /arch:AVX512 (see CMakeLists.txt)
+#define SIMD_KERNELS_NAME kernelsAVX512
+#define SIMD_INSTRUCTION_SET InstructionSet::AVX512
+#define SIMD_NAME "AVX-512"
+#include "simd_kernels.inl"
@@ -0,0 +1,5 @@
+// Baseline build of the math kernels, compiled without extra instruction set flags
+#define SIMD_KERNELS_NAME kernelsGeneric
+#define SIMD_INSTRUCTION_SET InstructionSet::Generic
+#define SIMD_NAME "Generic"
+#include "simd_kernels.inl"
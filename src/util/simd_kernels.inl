@@ -0,0 +1,305 @@
+// Kernel bodies shared by simd_*.cpp, each of them includes this file once with different
+// compiler flags. Everything stays in an anonymous namespace (and only calls C math functions)
+// so that no inline function compiled for a wide instruction set can be picked by the linker
+// for code running on a narrower CPU.
+//
+// Before including, define:
+//     SIMD_KERNELS_NAME      name of the function returning the kernel table
+//     SIMD_INSTRUCTION_SET   util::simd::InstructionSet value
+//     SIMD_NAME              printable name
+#include <cmath>
+#include <cstddef>
+
+#include "util/simd.h"
+
+namespace util {
+namespace simd {
+namespace {
+// sin and cos of x by Cody-Waite reduction to [-pi/4, pi/4] and minimax polynomials (Cephes coefficients),
+// written branch free so that loops calling it vectorize. Error is within a few ulp for |x| < 1e5.
+inline void polynomialSinCos(double x, double* sin_x, double* cos_x) {
+    const double two_over_pi = 0.63661977236758134308;
+    const double pi_over_2_hi = 1.57079632673412561417e+00;
+    const double pi_over_2_lo = 6.07710050650619224932e-11;
+    // Round to nearest integer with the 1.5 * 2^52 trick
+    const double round_magic = 6755399441055744.0;
+    double k = (x * two_over_pi + round_magic) - round_magic;
+    double r = (x - k * pi_over_2_hi) - k * pi_over_2_lo;
+    int quadrant = static_cast<int>(k);
+    double r2 = r * r;
+    double sin_r = 1.58962301576546568060e-10;
+    sin_r = sin_r * r2 - 2.50507477628578072866e-8;
+    sin_r = sin_r * r2 + 2.75573136213857245213e-6;
+    sin_r = sin_r * r2 - 1.98412698295895385996e-4;
+    sin_r = sin_r * r2 + 8.33333333332211858878e-3;
+    sin_r = sin_r * r2 - 1.66666666666666307295e-1;
+    sin_r = r + r * r2 * sin_r;
+    double cos_r = -1.13585365213876817300e-11;
+    cos_r = cos_r * r2 + 2.08757008419747316778e-9;
+    cos_r = cos_r * r2 - 2.75573141792967388112e-7;
+    cos_r = cos_r * r2 + 2.48015872888517045348e-5;
+    cos_r = cos_r * r2 - 1.38888888888730564116e-3;
+    cos_r = cos_r * r2 + 4.16666666666665929218e-2;
+    cos_r = 1.0 - 0.5 * r2 + r2 * r2 * cos_r;
+    // sin(x) by quadrant: s, c, -s, -c; cos(x): c, -s, -c, s
+    bool swap = (quadrant & 1) != 0;
+    double s = swap ? cos_r : sin_r;
+    double c = swap ? sin_r : cos_r;
+    *sin_x = (quadrant & 2) != 0 ? -s : s;
+    *cos_x = ((quadrant + 1) & 2) != 0 ? -c : c;
+}
+
+// Closed form product of the three half-angle rotations
+void eulerToQuaternionZYX(const double* __restrict euler, double angle_scale, double* __restrict quaternions,
+                          std::size_t n) {
+    const double half = 0.5 * angle_scale;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* e = euler + 4 * i;
+        double sx, cx, sy, cy, sz, cz;
+        polynomialSinCos(e[0] * half, &sx, &cx);
+        polynomialSinCos(e[1] * half, &sy, &cy);
+        polynomialSinCos(e[2] * half, &sz, &cz);
+        double* q = quaternions + 4 * i;
+        q[0] = sx * cy * cz - cx * sy * sz;
+        q[1] = cx * sy * cz + sx * cy * sz;
+        q[2] = cx * cy * sz - sx * sy * cz;
+        q[3] = cx * cy * cz + sx * sy * sz;
+    }
+}
+
+void eulerToQuaternionXYZ(const double* __restrict euler, double angle_scale, double* __restrict quaternions,
+                          std::size_t n) {
+    const double half = 0.5 * angle_scale;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* e = euler + 4 * i;
+        double sx, cx, sy, cy, sz, cz;
+        polynomialSinCos(e[0] * half, &sx, &cx);
+        polynomialSinCos(e[1] * half, &sy, &cy);
+        polynomialSinCos(e[2] * half, &sz, &cz);
+        double* q = quaternions + 4 * i;
+        q[0] = sx * cy * cz + cx * sy * sz;
+        q[1] = cx * sy * cz - sx * cy * sz;
+        q[2] = cx * cy * sz + sx * sy * cz;
+        q[3] = cx * cy * cz - sx * sy * sz;
+    }
+}
+
+void slerp(const double* __restrict from, const double* __restrict to, double t, double* __restrict out,
+           std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* a = from + 4 * i;
+        const double* b = to + 4 * i;
+        double d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        // Take the shortest path
+        double sign = d < 0.0 ? -1.0 : 1.0;
+        d *= sign;
+        double w0 = 1.0 - t, w1 = t;
+        // Fall back to linear interpolation when the quaternions are nearly parallel
+        if (d < 1.0 - 1e-9) {
+            double theta = acos(d);
+            double inverse_sin = 1.0 / sin(theta);
+            w0 = sin((1.0 - t) * theta) * inverse_sin;
+            w1 = sin(t * theta) * inverse_sin;
+        }
+        w1 *= sign;
+        double* q = out + 4 * i;
+        for (int k = 0; k < 4; ++k) q[k] = w0 * a[k] + w1 * b[k];
+    }
+}
+
+void nlerp(const double* __restrict from, const double* __restrict to, double t, double* __restrict out,
+           std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* a = from + 4 * i;
+        const double* b = to + 4 * i;
+        double d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        double w0 = 1.0 - t;
+        double w1 = d < 0.0 ? -t : t;
+        double q[4];
+        for (int k = 0; k < 4; ++k) q[k] = w0 * a[k] + w1 * b[k];
+        double inverse_norm = 1.0 / sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int k = 0; k < 4; ++k) out[4 * i + k] = q[k] * inverse_norm;
+    }
+}
+
+void blendQuaternions(const double* __restrict from, const double* __restrict to, const double* __restrict weights,
+                      double* __restrict out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* a = from + 4 * i;
+        const double* b = to + 4 * i;
+        double t = weights[i];
+        double d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        double w0 = 1.0 - t;
+        double w1 = d < 0.0 ? -t : t;
+        double q[4];
+        for (int k = 0; k < 4; ++k) q[k] = w0 * a[k] + w1 * b[k];
+        double inverse_norm = 1.0 / sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int k = 0; k < 4; ++k) out[4 * i + k] = q[k] * inverse_norm;
+    }
+}
+
+void multiplyQuaternions(const double* __restrict a, const double* __restrict b, double* __restrict out,
+                         std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* p = a + 4 * i;
+        const double* r = b + 4 * i;
+        double* q = out + 4 * i;
+        q[0] = p[3] * r[0] + p[0] * r[3] + p[1] * r[2] - p[2] * r[1];
+        q[1] = p[3] * r[1] - p[0] * r[2] + p[1] * r[3] + p[2] * r[0];
+        q[2] = p[3] * r[2] + p[0] * r[1] - p[1] * r[0] + p[2] * r[3];
+        q[3] = p[3] * r[3] - p[0] * r[0] - p[1] * r[1] - p[2] * r[2];
+    }
+}
+
+void rotateQuaternions(const double* __restrict rotation, const double* __restrict quaternions,
+                       double* __restrict out, std::size_t n) {
+    const double x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* b = quaternions + 4 * i;
+        double* q = out + 4 * i;
+        q[0] = w * b[0] + x * b[3] + y * b[2] - z * b[1];
+        q[1] = w * b[1] - x * b[2] + y * b[3] + z * b[0];
+        q[2] = w * b[2] + x * b[1] - y * b[0] + z * b[3];
+        q[3] = w * b[3] - x * b[0] - y * b[1] - z * b[2];
+    }
+}
+
+void transformPoints(const double* __restrict transform, const double* __restrict points, double* __restrict out,
+                     std::size_t n) {
+    const double* m = transform;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* p = points + 4 * i;
+        double* q = out + 4 * i;
+        double x = p[0], y = p[1], z = p[2], w = p[3];
+        q[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+        q[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+        q[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+        q[3] = w;
+    }
+}
+
+// c = a * b for column major 3 * 3 matrices
+void multiply3(const double* __restrict a, const double* __restrict b, double* __restrict c) {
+    for (int col = 0; col < 3; ++col) {
+        for (int row = 0; row < 3; ++row) {
+            c[col * 3 + row] = a[row] * b[col * 3] + a[3 + row] * b[col * 3 + 1] + a[6 + row] * b[col * 3 + 2];
+        }
+    }
+}
+
+// Column major rotation matrix of an unit quaternion (x y z w)
+void quaternionToMatrix(const double* q, double* m) {
+    double x = q[0], y = q[1], z = q[2], w = q[3];
+    m[0] = 1.0 - 2.0 * (y * y + z * z);
+    m[1] = 2.0 * (x * y + z * w);
+    m[2] = 2.0 * (x * z - y * w);
+    m[3] = 2.0 * (x * y - z * w);
+    m[4] = 1.0 - 2.0 * (x * x + z * z);
+    m[5] = 2.0 * (y * z + x * w);
+    m[6] = 2.0 * (x * z + y * w);
+    m[7] = 2.0 * (y * z - x * w);
+    m[8] = 1.0 - 2.0 * (x * x + y * y);
+}
+
+void forwardKinematics(const int* __restrict parents, const double* __restrict rest_rotations,
+                       const double* __restrict local_rotations, const double* __restrict offsets,
+                       const double* __restrict translations, double* __restrict rotations,
+                       double* __restrict start_positions, double* __restrict end_positions, std::size_t n) {
+    double local[9], rest_local[9];
+    for (std::size_t i = 0; i < n; ++i) {
+        quaternionToMatrix(local_rotations + 4 * i, local);
+        multiply3(rest_rotations + 9 * i, local, rest_local);
+        double* rotation = rotations + 9 * i;
+        double* start = start_positions + 4 * i;
+        const double* translation = translations + 4 * i;
+        int parent = parents[i];
+        if (parent < 0) {
+            for (int k = 0; k < 9; ++k) rotation[k] = rest_local[k];
+            for (int k = 0; k < 4; ++k) start[k] = translation[k];
+        } else {
+            multiply3(rotations + 9 * parent, rest_local, rotation);
+            const double* parent_end = end_positions + 4 * parent;
+            for (int k = 0; k < 4; ++k) start[k] = parent_end[k] + translation[k];
+        }
+        const double* offset = offsets + 4 * i;
+        double* end = end_positions + 4 * i;
+        for (int row = 0; row < 3; ++row) {
+            end[row] = start[row] + rotation[row] * offset[0] + rotation[3 + row] * offset[1] +
+                       rotation[6 + row] * offset[2];
+        }
+        end[3] = start[3] + offset[3];
+    }
+}
+
+void convolve(const double* __restrict input, std::size_t n, const double* __restrict taps, std::size_t tap_num,
+              double* __restrict out) {
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(n);
+    const std::ptrdiff_t radius = static_cast<std::ptrdiff_t>(tap_num / 2);
+    const std::ptrdiff_t interior_begin = radius < count ? radius : count;
+    const std::ptrdiff_t interior_end = count - radius > interior_begin ? count - radius : interior_begin;
+    // Interior samples, taps outer so that the inner loop is a contiguous stream
+    for (std::ptrdiff_t i = interior_begin; i < interior_end; ++i) out[i] = 0.0;
+    for (std::ptrdiff_t k = 0; k < static_cast<std::ptrdiff_t>(tap_num); ++k) {
+        const double tap = taps[k];
+        const double* shifted = input + (k - radius);
+        for (std::ptrdiff_t i = interior_begin; i < interior_end; ++i) out[i] += tap * shifted[i];
+    }
+    // Both ends with clamped indices
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        if (i == interior_begin) i = interior_end;
+        if (i >= count) break;
+        double sum = 0.0;
+        for (std::ptrdiff_t k = 0; k < static_cast<std::ptrdiff_t>(tap_num); ++k) {
+            std::ptrdiff_t j = i + k - radius;
+            j = j < 0 ? 0 : (j >= count ? count - 1 : j);
+            sum += taps[k] * input[j];
+        }
+        out[i] = sum;
+    }
+}
+
+void squaredDistances(const double* __restrict query, const double* __restrict vectors, std::size_t dimension,
+                      double* __restrict out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* v = vectors + i * dimension;
+        // Independent partial sums so that the reduction vectorizes without -ffast-math
+        double partial[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        std::size_t k = 0;
+        for (; k + 8 <= dimension; k += 8) {
+            for (int l = 0; l < 8; ++l) {
+                double d = query[k + l] - v[k + l];
+                partial[l] += d * d;
+            }
+        }
+        double sum = 0.0;
+        for (; k < dimension; ++k) sum += (query[k] - v[k]) * (query[k] - v[k]);
+        for (int l = 0; l < 8; ++l) sum += partial[l];
+        out[i] = sum;
+    }
+}
+void squaredDistancesColumns(const double* __restrict query, const double* __restrict vectors, std::size_t dimension,
+                             std::size_t stride, double* __restrict out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) out[i] = 0.0;
+    for (std::size_t k = 0; k < dimension; ++k) {
+        const double q = query[k];
+        const double* row = vectors + k * stride;
+        for (std::size_t i = 0; i < n; ++i) {
+            double d = q - row[i];
+            out[i] += d * d;
+        }
+    }
+}
+}  // namespace
+
+namespace detail {
+const Kernels& SIMD_KERNELS_NAME() {
+    static const Kernels table = {SIMD_INSTRUCTION_SET, SIMD_NAME,          &eulerToQuaternionZYX,
+                                  &eulerToQuaternionXYZ, &slerp,            &nlerp,
+                                  &blendQuaternions,     &multiplyQuaternions, &rotateQuaternions,
+                                  &transformPoints,      &forwardKinematics, &convolve,
+                                  &squaredDistances,     &squaredDistancesColumns};
+    return table;
+}
+}  // namespace detail
+}  // namespace simd
+}  // namespace util
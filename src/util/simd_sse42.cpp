@@ -0,0 +1,5 @@
+// SSE4.2 build of the math kernels, compiled with -msse4.2 (see CMakeLists.txt)
+#define SIMD_KERNELS_NAME kernelsSSE42
+#define SIMD_INSTRUCTION_SET InstructionSet::SSE42
+#define SIMD_NAME "SSE4.2"
+#include "simd_kernels.inl"
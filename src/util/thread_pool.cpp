@@ -0,0 +1,98 @@
+#include "util/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace util {
+namespace {
+// Shared by the caller and helper tasks of one parallelFor(), helpers may still hold it after the call returns
+struct ParallelForState {
+    std::function<void(std::size_t, std::size_t)> body;
+    std::size_t count = 0;
+    std::size_t chunk_size = 1;
+    std::size_t chunk_num = 0;
+    std::atomic<std::size_t> next_chunk{0};
+    std::atomic<std::size_t> finished_chunks{0};
+    std::mutex mutex;
+    std::condition_variable done;
+
+    // Take chunks until none left
+    void run() {
+        for (std::size_t chunk = next_chunk++; chunk < chunk_num; chunk = next_chunk++) {
+            std::size_t begin = chunk * chunk_size;
+            body(begin, std::min(count, begin + chunk_size));
+            if (++finished_chunks == chunk_num) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+};
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t thread_count) noexcept {
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    // The calling thread works too
+    workers.reserve(thread_count - 1);
+    for (std::size_t i = 1; i < thread_count; ++i) workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+std::size_t ThreadPool::getThreadNum() const { return workers.size() + 1; }
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t grain_size,
+                             const std::function<void(std::size_t, std::size_t)>& body) {
+    if (count == 0) return;
+    grain_size = std::max<std::size_t>(1, grain_size);
+    // A few chunks per thread for load balancing
+    std::size_t chunk_size = std::max(grain_size, count / (4 * getThreadNum()));
+    std::size_t chunk_num = (count + chunk_size - 1) / chunk_size;
+    if (chunk_num == 1 || workers.empty()) {
+        body(0, count);
+        return;
+    }
+    auto state = std::make_shared<ParallelForState>();
+    state->body = body;
+    state->count = count;
+    state->chunk_size = chunk_size;
+    state->chunk_num = chunk_num;
+    std::size_t helper_num = std::min(workers.size(), chunk_num - 1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::size_t i = 0; i < helper_num; ++i) tasks.emplace_back([state] { state->run(); });
+    }
+    task_ready.notify_all();
+    state->run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state] { return state->finished_chunks == state->chunk_num; });
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+}  // namespace util